@@ -0,0 +1,271 @@
+/**
+ * @file alias.c
+ * @brief Predicts set conflicts between A and B without simulating
+ *
+ * A blocked transpose works on one tile of A and the matching tile of B at
+ * a time. If the lines of the two tiles cannot all live in the cache at
+ * once because too many of them share a set, the tile thrashes. Here every
+ * tile is mapped onto the cache sets with simSet(), the indexing the
+ * simulator uses, and the lines above the associativity of each set are
+ * counted as conflicts.
+ *
+ * Set indices repeat every way of the cache: moving P = 2**(s+b) / 8
+ * doubles along a row, or P rows down, lands in the same set. Only tiles in
+ * the first P x P corner of A therefore need mapping, and the rest are
+ * counted by scaling. That keeps even MAXN x MAXN layouts, and the search
+ * over paddings and offsets, to a few milliseconds. Ragged tiles at the
+ * right and bottom edges are estimated from the full tiles.
+ *
+ * @author Yifan Gu
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alias.h"
+#include "sim.h"
+
+/**
+ * @brief Counts the lines of one tile in each set.
+ *
+ * @param[in]     layout Layout being analyzed
+ * @param[in]     ii     First row of the tile of A
+ * @param[in]     jj     First column of the tile of A
+ * @param[in]     tile   Tile edge in elements
+ * @param[in,out] count  Lines per set, all zero on entry
+ * @param[out]    used   Sets with a non-zero count, in first-use order
+ *
+ * @return The number of sets used
+ */
+static size_t map_tile(const alias_layout_t *layout, size_t ii, size_t jj,
+                       size_t tile, int s, int b, unsigned *count,
+                       unsigned long *used) {
+    size_t num_used = 0;
+    // The tile of A is rows [ii, ii + tile) x columns [jj, jj + tile); the
+    // tile of B is rows [jj, jj + tile) x columns [ii, ii + tile).
+    for (int m = 0; m < 2; m++) {
+        uintptr_t base = m == 0 ? layout->A : layout->B;
+        size_t ld = m == 0 ? layout->lda : layout->ldb;
+        size_t rows = m == 0 ? layout->N : layout->M;
+        size_t cols = m == 0 ? layout->M : layout->N;
+        size_t r0 = m == 0 ? ii : jj;
+        size_t c0 = m == 0 ? jj : ii;
+        size_t r1 = r0 + tile < rows ? r0 + tile : rows;
+        size_t c1 = c0 + tile < cols ? c0 + tile : cols;
+
+        for (size_t r = r0; r < r1; r++) {
+            uintptr_t first = base + (r * ld + c0) * sizeof(double);
+            uintptr_t last = base + (r * ld + c1) * sizeof(double) - 1;
+            for (uintptr_t block = first >> b; block <= last >> b; block++) {
+                unsigned long set = simSet((unsigned long)block << b, s, b);
+                if (count[set]++ == 0) {
+                    used[num_used++] = set;
+                }
+            }
+        }
+    }
+    return num_used;
+}
+
+/**
+ * @brief Smallest number of rows apart that start in the same set.
+ *
+ * @return The distance, or 0 if no two rows do
+ */
+static size_t alias_distance(uintptr_t base, size_t ld, size_t rows, int s,
+                             int b) {
+    unsigned long set0 = simSet((unsigned long)base, s, b);
+    for (size_t d = 1; d < rows; d++) {
+        if (simSet((unsigned long)(base + d * ld * sizeof(double)), s, b) ==
+            set0) {
+            return d;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Maps the tiles of a layout onto the sets of a cache.
+ *
+ * @param[in]  layout  Layout of A and B
+ * @param[in]  tile    Tile edge of the transpose, in elements
+ * @param[in]  s       Number of set index bits
+ * @param[in]  E       Number of lines per set
+ * @param[in]  b       Number of block bits
+ * @param[out] report  Summary of the mapping
+ * @param[out] density If not NULL, receives for each of the 2**s sets the
+ *                     mean number of lines a tile puts there
+ */
+void aliasAnalyze(const alias_layout_t *layout, size_t tile, int s, int E,
+                  int b, alias_report_t *report, double *density) {
+    size_t sets = (size_t)1 << s;
+    size_t period = ((size_t)1 << (s + b)) / sizeof(double);
+    size_t rows = layout->N < period ? layout->N : period;
+    size_t cols = layout->M < period ? layout->M : period;
+    unsigned *count = calloc(sets, sizeof(unsigned));
+    unsigned long *used = malloc(sets * sizeof(unsigned long));
+
+    memset(report, 0, sizeof(*report));
+    if (density != NULL) {
+        memset(density, 0, sets * sizeof(double));
+    }
+    if (count == NULL || used == NULL) {
+        free(count);
+        free(used);
+        return;
+    }
+
+    double tiles = 0;
+    double conflicts = 0;
+    double lines = 0;
+    double sets_used = 0;
+    for (size_t ii = 0; ii < rows; ii += tile) {
+        for (size_t jj = 0; jj < cols; jj += tile) {
+            size_t num_used = map_tile(layout, ii, jj, tile, s, b, count, used);
+            for (size_t u = 0; u < num_used; u++) {
+                unsigned long set = used[u];
+                lines += count[set];
+                if (count[set] > (unsigned)E) {
+                    conflicts += count[set] - (unsigned)E;
+                }
+                if (count[set] > report->worst_lines) {
+                    report->worst_lines = count[set];
+                    report->worst_set = set;
+                }
+                if (density != NULL) {
+                    density[set] += count[set];
+                }
+                count[set] = 0;
+            }
+            sets_used += (double)num_used;
+            tiles++;
+        }
+    }
+
+    double all_tiles = (double)((layout->N + tile - 1) / tile) *
+                       (double)((layout->M + tile - 1) / tile);
+    report->conflicts = conflicts * all_tiles / tiles;
+    report->mean_lines = lines / sets_used;
+    report->alias_a = alias_distance(layout->A, layout->lda, layout->N, s, b);
+    report->alias_b = alias_distance(layout->B, layout->ldb, layout->M, s, b);
+    if (density != NULL) {
+        for (size_t set = 0; set < sets; set++) {
+            density[set] /= tiles;
+        }
+    }
+    free(count);
+    free(used);
+}
+
+/**
+ * @brief Lays out A and B with their rows padded and B moved.
+ *
+ * Unpadded, B stays where the layout puts it, moved by offset bytes. A
+ * padded A grows past where B started, so B then starts offset bytes after
+ * the end of the padded A instead.
+ *
+ * @param[in]  layout Layout of A and B; its lda and ldb are ignored
+ * @param[in]  pad    Doubles added to the rows of A and B
+ * @param[in]  offset Bytes B is moved by
+ * @param[out] padded The resulting layout
+ */
+void aliasPadLayout(const alias_layout_t *layout, size_t pad, size_t offset,
+                    alias_layout_t *padded) {
+    *padded = *layout;
+    padded->lda = layout->M + pad;
+    padded->ldb = layout->N + pad;
+    padded->B = pad == 0 ? layout->B + offset
+                         : layout->A + layout->N * padded->lda * sizeof(double) +
+                               offset;
+}
+
+/**
+ * @brief Whether A and B of a layout share any byte.
+ */
+bool aliasOverlap(const alias_layout_t *layout) {
+    uintptr_t a_end = layout->A + layout->N * layout->lda * sizeof(double);
+    uintptr_t b_end = layout->B + layout->M * layout->ldb * sizeof(double);
+    return layout->A < b_end && layout->B < a_end;
+}
+
+/**
+ * @brief Estimated conflicts of a layout with its rows padded and B moved.
+ *
+ * @return False, leaving conflicts alone, if A and B would overlap
+ */
+static bool conflicts_of(const alias_layout_t *layout, size_t pad,
+                         size_t offset, size_t tile, int s, int E, int b,
+                         double *conflicts) {
+    alias_layout_t trial;
+    aliasPadLayout(layout, pad, offset, &trial);
+    if (aliasOverlap(&trial)) {
+        return false;
+    }
+
+    alias_report_t report;
+    aliasAnalyze(&trial, tile, s, E, b, &report, NULL);
+    *conflicts = report.conflicts;
+    return true;
+}
+
+/**
+ * @brief Finds the row padding and B offset with the fewest conflicts.
+ *
+ * Every block-aligned offset of B within one way of the cache is tried
+ * first, since anything larger repeats a smaller one, and then every
+ * padding of whole blocks up to one way on the rows of both A and B. A
+ * padded B starts after the padded A, at the offset that puts it in the
+ * same sets as the best unpadded B. Searching the two in turn rather than
+ * jointly keeps the cost to about a hundred analyses. Layouts in which A
+ * and B overlap are never scored. Ties go to the smaller value.
+ *
+ * @param[in]  layout    Layout of A and B; its lda and ldb are ignored
+ * @param[in]  tile      Tile edge of the transpose, in elements
+ * @param[in]  s         Number of set index bits
+ * @param[in]  E         Number of lines per set
+ * @param[in]  b         Number of block bits
+ * @param[out] pad       Doubles to add to the rows of A and B
+ * @param[out] offset    Bytes to move B by, as aliasPadLayout() applies it
+ * @param[out] conflicts Estimated conflicts of the best layout
+ */
+void aliasBestLayout(const alias_layout_t *layout, size_t tile, int s, int E,
+                     int b, size_t *pad, size_t *offset, double *conflicts) {
+    size_t block_bytes = (size_t)1 << b;
+    size_t block = block_bytes > sizeof(double) ? block_bytes / sizeof(double)
+                                                : 1;
+    size_t way = (size_t)1 << (s + b);
+
+    *pad = 0;
+    *offset = 0;
+    *conflicts = 0;
+    bool found = conflicts_of(layout, 0, 0, tile, s, E, b, conflicts);
+    for (size_t off = block_bytes; off < way && (!found || *conflicts > 0);
+         off += block_bytes) {
+        double c;
+        if (conflicts_of(layout, 0, off, tile, s, E, b, &c) &&
+            (!found || c < *conflicts)) {
+            *offset = off;
+            *conflicts = c;
+            found = true;
+        }
+    }
+
+    // Where the best unpadded B starts, modulo one way
+    uintptr_t target = layout->B + *offset;
+    for (size_t p = block; p < way / sizeof(double) &&
+                           (!found || *conflicts > 0);
+         p += block) {
+        uintptr_t end = layout->A + layout->N * (layout->M + p) *
+                                        sizeof(double);
+        size_t off = (size_t)((target - end) & (way - 1));
+        double c;
+        if (conflicts_of(layout, p, off, tile, s, E, b, &c) &&
+            (!found || c < *conflicts)) {
+            *pad = p;
+            *offset = off;
+            *conflicts = c;
+            found = true;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/**
+ * @file alias.h
+ * @brief Prototypes for the static set-aliasing analyzer
+ */
+
+#ifndef ALIAS_TOOLS_H
+#define ALIAS_TOOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Struct representing a layout of A and B in memory
+ */
+typedef struct {
+    size_t M;    // width of A, height of B
+    size_t N;    // height of A, width of B
+    size_t lda;  // doubles between rows of A, at least M
+    size_t ldb;  // doubles between rows of B, at least N
+    uintptr_t A; // address of A[0][0]
+    uintptr_t B; // address of B[0][0]
+} alias_layout_t;
+
+/**
+ * @brief Struct representing how a layout maps onto the cache sets
+ */
+typedef struct {
+    size_t alias_a;          // rows of A apart that start in the same set
+    size_t alias_b;          // rows of B apart that start in the same set
+    double conflicts;        // estimated lines over associativity, all tiles
+    double mean_lines;       // mean lines a tile puts in each set it uses
+    unsigned long worst_set; // set holding the most lines of one tile
+    unsigned worst_lines;    // lines of one tile in that set
+} alias_report_t;
+
+/** @brief Maps the tiles of a layout onto the sets of a cache */
+void aliasAnalyze(const alias_layout_t *layout, size_t tile, int s, int E,
+                  int b, alias_report_t *report, double *density);
+
+/** @brief Lays out A and B with their rows padded and B moved */
+void aliasPadLayout(const alias_layout_t *layout, size_t pad, size_t offset,
+                    alias_layout_t *padded);
+
+/** @brief Whether A and B of a layout share any byte */
+bool aliasOverlap(const alias_layout_t *layout);
+
+/** @brief Finds the row padding and B offset with the fewest conflicts */
+void aliasBestLayout(const alias_layout_t *layout, size_t tile, int s, int E,
+                     int b, size_t *pad, size_t *offset, double *conflicts);
+
+#endif /* ALIAS_TOOLS_H */
@@ -0,0 +1,192 @@
+/**
+ * @file alloc.c
+ * @brief Matrix allocation with controlled alignment and page size
+ *
+ * Where a matrix lands decides how many TLB entries a transpose needs and
+ * how its rows map onto cache sets, so a harness that lets malloc() choose
+ * sees results swing between runs. Each kind here fixes the alignment and
+ * the page size instead. A kind the system cannot provide falls back to the
+ * next smaller one: explicit huge pages need a hugetlb pool
+ * (/proc/sys/vm/nr_hugepages), and transparent huge pages need THP to be
+ * enabled at least in madvise mode. madvise() succeeds even when THP is
+ * off, so a THP region is only labelled as such once its first huge page
+ * shows up as AnonHugePages in /proc/self/smaps. The kind actually
+ * obtained is recorded in the region so callers can report it.
+ *
+ * @author Yifan Gu
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+
+static const char *const kind_names[ALLOC_NUM_KINDS] = {
+    [ALLOC_MALLOC] = "malloc",
+    [ALLOC_PAGE] = "page",
+    [ALLOC_THP] = "thp",
+    [ALLOC_HUGETLB] = "hugetlb",
+};
+
+/**
+ * @brief Maps bytes of anonymous memory aligned to align.
+ *
+ * @return The aligned start, or NULL on failure
+ */
+static void *map_aligned(alloc_region_t *region, size_t bytes, size_t align,
+                         int flags) {
+    size_t map_bytes = bytes + align;
+    void *map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    region->map = map;
+    region->map_bytes = map_bytes;
+    uintptr_t start = ((uintptr_t)map + align - 1) & ~(uintptr_t)(align - 1);
+    return (void *)start;
+}
+
+/**
+ * @brief Returns true if THP is set to always or madvise in sysfs.
+ */
+static bool thp_enabled(void) {
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (fp == NULL) {
+        return false;
+    }
+    char line[128];
+    bool enabled = fgets(line, sizeof(line), fp) != NULL &&
+                   strstr(line, "[never]") == NULL;
+    fclose(fp);
+    return enabled;
+}
+
+/**
+ * @brief Returns true if the mapping holding p has any huge pages.
+ */
+static bool huge_backed(const void *p) {
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    if (fp == NULL) {
+        return false;
+    }
+    char line[256];
+    bool inside = false;
+    bool backed = false;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        uintptr_t lo, hi;
+        unsigned long kb;
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            inside = (uintptr_t)p >= lo && (uintptr_t)p < hi;
+        } else if (inside && sscanf(line, "AnonHugePages: %lu", &kb) == 1) {
+            backed = kb > 0;
+            break;
+        }
+    }
+    fclose(fp);
+    return backed;
+}
+
+/**
+ * @brief Allocates bytes placed as kind, falling back to smaller pages.
+ *
+ * @param[out] region Allocated buffer and the placement obtained
+ * @param[in]  kind   Placement requested
+ * @param[in]  bytes  Length of the buffer
+ *
+ * @return False if no memory could be allocated, true otherwise
+ */
+bool allocRegion(alloc_region_t *region, alloc_kind_t kind, size_t bytes) {
+    memset(region, 0, sizeof(*region));
+
+    if (kind == ALLOC_HUGETLB) {
+        size_t huge = (bytes + ALLOC_HUGE_BYTES - 1) & ~(ALLOC_HUGE_BYTES - 1);
+        void *map = mmap(NULL, huge, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (map != MAP_FAILED) {
+            region->ptr = region->map = map;
+            region->map_bytes = huge;
+            region->kind = ALLOC_HUGETLB;
+            return true;
+        }
+        kind = ALLOC_THP;
+    }
+
+    if (kind == ALLOC_THP && bytes >= ALLOC_HUGE_BYTES && thp_enabled()) {
+        region->ptr = map_aligned(region, bytes, ALLOC_HUGE_BYTES, 0);
+        if (region->ptr == NULL) {
+            return false;
+        }
+        if (madvise(region->map, region->map_bytes, MADV_HUGEPAGE) == 0) {
+            // Fault in the first huge page to see what backs the region
+            *(volatile char *)region->ptr = 0;
+            if (huge_backed(region->ptr)) {
+                region->kind = ALLOC_THP;
+                return true;
+            }
+        }
+        munmap(region->map, region->map_bytes);
+        region->map = NULL;
+    }
+    if (kind == ALLOC_THP) {
+        kind = ALLOC_PAGE;
+    }
+
+    if (kind == ALLOC_PAGE) {
+        region->ptr = map_aligned(region, bytes, 4096, 0);
+        if (region->ptr == NULL) {
+            return false;
+        }
+#ifdef MADV_NOHUGEPAGE
+        madvise(region->map, region->map_bytes, MADV_NOHUGEPAGE);
+#endif
+        region->kind = ALLOC_PAGE;
+        return true;
+    }
+
+    region->ptr = aligned_alloc(64, (bytes + 63) & ~(size_t)63);
+    region->kind = ALLOC_MALLOC;
+    return region->ptr != NULL;
+}
+
+/**
+ * @brief Releases a buffer from allocRegion().
+ */
+void allocFree(alloc_region_t *region) {
+    if (region->map != NULL) {
+        munmap(region->map, region->map_bytes);
+    } else {
+        free(region->ptr);
+    }
+    memset(region, 0, sizeof(*region));
+}
+
+/**
+ * @brief Short name of kind.
+ */
+const char *allocKindName(alloc_kind_t kind) {
+    return kind_names[kind];
+}
+
+/**
+ * @brief Parses a name from allocKindName().
+ *
+ * @param[in]  name Name to parse
+ * @param[out] kind Matching kind
+ *
+ * @return False if name is unknown, true otherwise
+ */
+bool allocKindParse(const char *name, alloc_kind_t *kind) {
+    for (int k = 0; k < ALLOC_NUM_KINDS; k++) {
+        if (strcmp(name, kind_names[k]) == 0) {
+            *kind = (alloc_kind_t)k;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file alloc.h
+ * @brief Prototypes for the placement-controlled matrix allocator
+ */
+
+#ifndef ALLOC_TOOLS_H
+#define ALLOC_TOOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Size of a huge page */
+#define ALLOC_HUGE_BYTES ((size_t)2 << 20)
+
+/**
+ * @brief Enum of the ways a buffer can be placed in memory
+ */
+typedef enum {
+    ALLOC_MALLOC,  // aligned_alloc(), 64-byte aligned
+    ALLOC_PAGE,    // 4KB-aligned mapping kept on 4KB pages
+    ALLOC_THP,     // 2MB-aligned mapping advised to use transparent huge pages
+    ALLOC_HUGETLB, // explicit 2MB huge pages from the hugetlb pool
+    ALLOC_NUM_KINDS
+} alloc_kind_t;
+
+/**
+ * @brief Struct representing one allocated buffer
+ */
+typedef struct {
+    void *ptr;         // first usable byte
+    void *map;         // start of the mapping, NULL for ALLOC_MALLOC
+    size_t map_bytes;  // length of the mapping
+    alloc_kind_t kind; // placement actually obtained
+} alloc_region_t;
+
+/** @brief Allocates bytes placed as kind, falling back to smaller pages */
+bool allocRegion(alloc_region_t *region, alloc_kind_t kind, size_t bytes);
+
+/** @brief Releases a buffer from allocRegion() */
+void allocFree(alloc_region_t *region);
+
+/** @brief Short name of kind */
+const char *allocKindName(alloc_kind_t kind);
+
+/** @brief Parses a name from allocKindName(); false if unknown */
+bool allocKindParse(const char *name, alloc_kind_t *kind);
+
+#endif /* ALLOC_TOOLS_H */
@@ -0,0 +1,645 @@
+/**
+ * @file bench.c
+ * @author Yifan Gu
+ * @brief Wall-clock benchmark of every registered transpose function
+ *
+ * Each function in func_list is run on each requested shape: first a few
+ * untimed warm-up runs, then the timed runs. In warm mode the matrices stay
+ * wherever the previous run left them; in cold mode A, B and tmp are
+ * flushed from every cache level before each timed run. The best, median
+ * and 95th percentile times are reported, along with the effective
+ * bandwidth of the median (one read of A and one write of B).
+ *
+ * A and B share one buffer from alloc.h: A at its start, B at the next 4KB
+ * boundary after A plus an optional offset. Each -a placement is measured
+ * in turn, so 4KB pages, transparent and explicit huge pages and plain
+ * malloc() can be compared on the same shapes.
+ *
+ * With -R, copy, read and write bandwidth are first measured with
+ * STREAM-like loops over working sets of half the L1, L2 and LLC, and over
+ * one larger than the LLC. Each transpose is then also reported as the
+ * fraction of the copy bandwidth it reaches at the level its working set
+ * (A plus B) fits in; cold runs are held to the DRAM roof.
+ *
+ * Command-line usage:
+ *   ./bench [-R] [-r <reps>] [-w <warmups>] [-m <mode>] [-f <filter>]
+ *           [-a <placement>]... [-O <bytes>] [-o <csv>] [-c <csv>]
+ *           [<M>x<N> ...]
+ *   ./bench -h
+ *
+ * -h    Print this help message and exit
+ * -R    Measure bandwidth roofs and report each result against them
+ * -r    <reps> Number of timed runs per function and shape (default 11)
+ * -w    <warmups> Number of untimed runs before them (default 2)
+ * -m    <mode> warm, cold or both (default both)
+ * -f    <filter> Only run functions whose description contains <filter>
+ * -a    <placement> malloc, page, thp, hugetlb or all (default malloc)
+ * -O    <bytes> Extra offset of B, a multiple of 8 (default 0)
+ * -o    <csv> Also write the results to <csv>
+ * -c    <csv> Compare the medians against an earlier -o file
+ *
+ * Every function is checked against correctTrans() once, untimed, before
+ * it is measured. The kernels' own assert(is_transpose()) checks, present
+ * unless trans.c is built with NDEBUG, are switched off with TRANS_VERIFY
+ * (see verify.c), so the times do not depend on the build flags.
+ *
+ * Without shapes, 64x64, 1024x1024 and 4096x4096 are measured. The CSV
+ * columns are: function,M,N,mode,placement,reps,best_s,median_s,p95_s,gbps,
+ * roof, where placement is the one actually obtained after any fallback
+ * and roof is the fraction of the bandwidth roof reached (0 without -R).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "cache.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+/** @brief Most shapes accepted on the command line */
+#define BENCH_MAX_SHAPES 64
+
+/** @brief Longest line accepted from a baseline CSV file */
+#define BENCH_MAX_LINE 512
+
+/** @brief Bytes in an eviction buffer when cache lines cannot be flushed */
+#define BENCH_EVICT_BYTES ((size_t)256 << 20)
+
+/** @brief Largest working set used for the DRAM bandwidth roof */
+#define ROOF_MAX_BYTES ((size_t)1 << 30)
+
+/** @brief Shortest time one bandwidth trial runs for, in seconds */
+#define ROOF_TRIAL_SECONDS 0.02
+
+/** @brief Number of bandwidth trials; the best is kept */
+#define ROOF_TRIALS 3
+
+/**
+ * @brief Enum of the memory levels bandwidth roofs are measured at
+ */
+typedef enum {
+    ROOF_L1,
+    ROOF_L2,
+    ROOF_LLC,
+    ROOF_DRAM,
+    ROOF_NUM_LEVELS
+} roof_level_t;
+
+/**
+ * @brief Struct representing the bandwidth measured at one memory level
+ */
+typedef struct {
+    const char *name;
+    size_t capacity; // bytes the level holds, 0 for DRAM
+    size_t working;  // bytes the bandwidth loops touch
+    double copy;     // GB/s, counting the bytes read and written
+    double read;     // GB/s
+    double write;    // GB/s
+} roof_t;
+
+/**
+ * @brief Struct representing the timing summary of one benchmark
+ */
+typedef struct {
+    double best;   // fastest run, in seconds
+    double median; // median run, in seconds
+    double p95;    // 95th percentile run, in seconds
+    double gbps;   // bytes moved per second at the median, in GB/s
+} bench_result_t;
+
+/**
+ * @brief Struct representing one row of a baseline CSV file
+ */
+typedef struct {
+    char function[128];
+    size_t M;
+    size_t N;
+    char mode[8];
+    char placement[16];
+    double median;
+} baseline_t;
+
+static double tmp[TMPCOUNT];
+static int reps = 11;
+static int warmups = 2;
+static bool run_warm = true;
+static bool run_cold = true;
+static const char *filter = NULL;
+static size_t offset = 0;
+static FILE *csv = NULL;
+static bool roofline = false;
+static roof_t roofs[ROOF_NUM_LEVELS];
+static baseline_t *baseline = NULL;
+static size_t baseline_len = 0;
+
+/**
+ * @brief Print help message when -h option is called or param error.
+ */
+static void printHelpMessage(void) {
+    printf("Usage: ./bench [-R] [-r <reps>] [-w <warmups>] [-m <mode>] "
+           "[-f <filter>]\n");
+    printf("               [-a <placement>]... [-O <bytes>] [-o <csv>] "
+           "[-c <csv>]\n");
+    printf("               [<M>x<N> ...]\n");
+    printf("       ./bench -h\n\n");
+    printf("  -h            Print this help message and exit\n");
+    printf("  -R            Measure bandwidth roofs and report against them\n");
+    printf("  -r <reps>     Number of timed runs (default 11)\n");
+    printf("  -w <warmups>  Number of untimed runs before them (default 2)\n");
+    printf("  -m <mode>     warm, cold or both (default both)\n");
+    printf("  -f <filter>   Only run functions whose description contains "
+           "<filter>\n");
+    printf("  -a <placement> malloc, page, thp, hugetlb or all "
+           "(default malloc)\n");
+    printf("  -O <bytes>    Extra offset of B, a multiple of 8\n");
+    printf("  -o <csv>      Also write the results to <csv>\n");
+    printf("  -c <csv>      Compare the medians against an earlier -o file\n");
+}
+
+/**
+ * @brief Returns the current time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Compares two doubles for qsort.
+ */
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Evicts bytes starting at p from every cache level.
+ *
+ * On x86 each line is flushed with clflush. Elsewhere a buffer larger than
+ * any cache is written instead, pushing everything else out.
+ */
+static void flush(const void *p, size_t bytes) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    const char *c = p;
+    for (size_t off = 0; off < bytes; off += 64) {
+        _mm_clflush(c + off);
+    }
+    _mm_mfence();
+#else
+    static volatile char *evict = NULL;
+    if (evict == NULL) {
+        evict = malloc(BENCH_EVICT_BYTES);
+        if (evict == NULL) {
+            return;
+        }
+    }
+    for (size_t off = 0; off < BENCH_EVICT_BYTES; off += 64) {
+        evict[off] = (char)off;
+    }
+    (void)p;
+    (void)bytes;
+#endif
+}
+
+/**
+ * @brief Times one function on one shape.
+ *
+ * @param[in]  f       Index of the function in func_list
+ * @param[in]  M       Width of A
+ * @param[in]  N       Height of A
+ * @param[in]  A       Source matrix
+ * @param[out] B       Destination matrix
+ * @param[in]  cold    Flush A, B and tmp before every timed run
+ * @param[out] result  Timing summary
+ */
+static void bench_one(int f, size_t M, size_t N, double *A, double *B,
+                      bool cold, bench_result_t *result) {
+    size_t bytes = M * N * sizeof(double);
+    double *samples = malloc((size_t)reps * sizeof(double));
+    if (samples == NULL) {
+        printf("Invalid sample memory\n");
+        exit(1);
+    }
+
+    for (int w = 0; w < warmups; w++) {
+        func_list[f].func_ptr(M, N, (double(*)[M])A, (double(*)[N])B, tmp);
+    }
+    for (int r = 0; r < reps; r++) {
+        if (cold) {
+            flush(A, bytes);
+            flush(B, bytes);
+            flush(tmp, sizeof(tmp));
+        }
+        double start = now();
+        func_list[f].func_ptr(M, N, (double(*)[M])A, (double(*)[N])B, tmp);
+        samples[r] = now() - start;
+    }
+
+    qsort(samples, (size_t)reps, sizeof(double), compare_double);
+    result->best = samples[0];
+    result->median = samples[reps / 2];
+    result->p95 = samples[(size_t)((reps - 1) * 95 + 99) / 100];
+    result->gbps = 2.0 * (double)bytes / result->median / 1e9;
+    free(samples);
+}
+
+/**
+ * @brief Reads the size of a cache level from sysconf, or uses fallback.
+ */
+static size_t cache_size(int name, size_t fallback) {
+    long reported = sysconf(name);
+    return reported > 0 ? (size_t)reported : fallback;
+}
+
+/** @brief Vector of doubles the read loop accumulates into */
+typedef double roof_vec_t __attribute__((vector_size(64)));
+
+/**
+ * @brief Copies the first half of buf over the second.
+ */
+static void roof_copy(double *buf, size_t n) {
+    memcpy(buf + n / 2, buf, n / 2 * sizeof(double));
+}
+
+/**
+ * @brief Sums buf, in four independent vector chains so the loads overlap.
+ *
+ * Cloned per instruction set so that the vectors map onto single registers
+ * wherever the CPU allows.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+static void roof_read(double *buf, size_t n) {
+    static volatile double sink;
+    const roof_vec_t *v = (const roof_vec_t *)buf;
+    roof_vec_t acc[4] = {{0}};
+    for (size_t i = 0; i + 4 <= n / 8; i += 4) {
+        for (size_t k = 0; k < 4; k++) {
+            acc[k] += v[i + k];
+        }
+    }
+    roof_vec_t sum = acc[0] + acc[1] + acc[2] + acc[3];
+    sink = sum[0] + sum[1] + sum[2] + sum[3] + sum[4] + sum[5] + sum[6] +
+           sum[7];
+    (void)sink;
+}
+
+/**
+ * @brief Fills buf with zeros.
+ */
+static void roof_write(double *buf, size_t n) {
+    memset(buf, 0, n * sizeof(double));
+}
+
+/**
+ * @brief Best bandwidth of one loop over n doubles, in GB/s.
+ *
+ * @param[in] loop  The loop to time
+ * @param[in] buf   Buffer it runs over, already touched and 64-byte aligned
+ * @param[in] n     Length of buf in doubles, a multiple of 32
+ * @param[in] bytes Bytes one pass moves
+ */
+static double roof_measure(void (*loop)(double *, size_t), double *buf,
+                           size_t n, double bytes) {
+    double best = 0;
+    for (int t = 0; t < ROOF_TRIALS; t++) {
+        long passes = 0;
+        double start = now();
+        double elapsed;
+        do {
+            loop(buf, n);
+            passes++;
+            elapsed = now() - start;
+        } while (elapsed < ROOF_TRIAL_SECONDS);
+        double gbps = bytes * (double)passes / elapsed / 1e9;
+        best = gbps > best ? gbps : best;
+    }
+    return best;
+}
+
+/**
+ * @brief Measures copy, read and write bandwidth at every memory level.
+ *
+ * @return False if a working set cannot be allocated, true otherwise
+ */
+static bool measure_roofs(void) {
+    size_t l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, (size_t)32 << 10);
+    size_t l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, (size_t)256 << 10);
+    size_t llc = cache_size(_SC_LEVEL3_CACHE_SIZE, (size_t)8 << 20);
+    size_t dram = 4 * llc < ROOF_MAX_BYTES ? 4 * llc : ROOF_MAX_BYTES;
+    roofs[ROOF_L1] = (roof_t){"L1", l1, l1 / 2, 0, 0, 0};
+    roofs[ROOF_L2] = (roof_t){"L2", l2, l2 / 2, 0, 0, 0};
+    roofs[ROOF_LLC] = (roof_t){"LLC", llc, llc / 2, 0, 0, 0};
+    roofs[ROOF_DRAM] = (roof_t){"DRAM", 0, dram, 0, 0, 0};
+
+    printf("Bandwidth roofs\n");
+    printf("  %-5s %14s %10s %10s %10s\n", "level", "working bytes",
+           "copy GB/s", "read GB/s", "write GB/s");
+    for (int l = 0; l < ROOF_NUM_LEVELS; l++) {
+        roof_t *roof = &roofs[l];
+        size_t n = roof->working / sizeof(double) / 32 * 32;
+        double *buf = aligned_alloc(64, n * sizeof(double));
+        if (buf == NULL) {
+            printf("Invalid roof memory\n");
+            return false;
+        }
+        roof_write(buf, n);
+        double bytes = (double)(n * sizeof(double));
+        roof->copy = roof_measure(roof_copy, buf, n, bytes);
+        roof->read = roof_measure(roof_read, buf, n, bytes);
+        roof->write = roof_measure(roof_write, buf, n, bytes);
+        free(buf);
+        printf("  %-5s %14zu %10.2f %10.2f %10.2f\n", roof->name, n * 8,
+               roof->copy, roof->read, roof->write);
+    }
+    printf("\n");
+    return true;
+}
+
+/**
+ * @brief The roof a transpose moving bytes of A and B is held to.
+ */
+static const roof_t *roof_for(size_t bytes, bool cold) {
+    if (!cold) {
+        for (int l = 0; l < ROOF_DRAM; l++) {
+            if (bytes <= roofs[l].capacity) {
+                return &roofs[l];
+            }
+        }
+    }
+    return &roofs[ROOF_DRAM];
+}
+
+/**
+ * @brief Loads the rows of an earlier -o file for comparison.
+ *
+ * @return False if the file cannot be read, true otherwise
+ */
+static bool load_baseline(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("File opening error.\n");
+        return false;
+    }
+
+    char line[BENCH_MAX_LINE];
+    size_t cap = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        baseline_t row;
+        if (sscanf(line, "%127[^,],%zu,%zu,%7[^,],%15[^,],%*d,%*f,%lf",
+                   row.function, &row.M, &row.N, row.mode, row.placement,
+                   &row.median) != 6) {
+            continue; // header or malformed line
+        }
+        if (baseline_len == cap) {
+            cap = cap > 0 ? 2 * cap : 64;
+            baseline_t *grown = realloc(baseline, cap * sizeof(baseline_t));
+            if (grown == NULL) {
+                break;
+            }
+            baseline = grown;
+        }
+        baseline[baseline_len++] = row;
+    }
+    fclose(fp);
+    return true;
+}
+
+/**
+ * @brief Finds the baseline median for one benchmark.
+ *
+ * @return The median in seconds, or 0 if the baseline lacks this row
+ */
+static double baseline_median(const char *function, size_t M, size_t N,
+                              const char *mode, const char *placement) {
+    for (size_t i = 0; i < baseline_len; i++) {
+        if (baseline[i].M == M && baseline[i].N == N &&
+            strcmp(baseline[i].mode, mode) == 0 &&
+            strcmp(baseline[i].placement, placement) == 0 &&
+            strcmp(baseline[i].function, function) == 0) {
+            return baseline[i].median;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Benchmarks every selected function on one shape and placement.
+ *
+ * A placement that falls back to one also selected in kinds is skipped.
+ *
+ * @return False if the matrices cannot be allocated, true otherwise
+ */
+static bool bench_shape(size_t M, size_t N, alloc_kind_t kind,
+                        const bool kinds[ALLOC_NUM_KINDS]) {
+    size_t bytes = M * N * sizeof(double);
+    size_t b_start = (bytes + 4095) / 4096 * 4096 + offset;
+    alloc_region_t region;
+    double *ref = malloc(bytes);
+    if (ref == NULL || !allocRegion(&region, kind, b_start + bytes)) {
+        printf("Invalid matrix memory\n");
+        free(ref);
+        return false;
+    }
+    double *A = region.ptr;
+    double *B = (double *)((char *)region.ptr + b_start);
+    const char *placement = allocKindName(region.kind);
+    if (region.kind != kind && kinds[region.kind]) {
+        printf("%zux%zu, %s unavailable, measured as %s\n", M, N,
+               allocKindName(kind), placement);
+        allocFree(&region);
+        free(ref);
+        return true;
+    }
+
+    initMatrix(M, N, (double(*)[M])A, (double(*)[N])B);
+    correctTrans(M, N, (double(*)[M])A, (double(*)[N])ref);
+
+    printf("%zux%zu, %s", M, N, placement);
+    if (region.kind != kind) {
+        printf(" (%s unavailable)", allocKindName(kind));
+    }
+    printf(", B offset %zu\n", offset);
+    printf("  %-40s %-4s %12s %12s %12s %8s%s\n", "function", "mode",
+           "best us", "median us", "p95 us", "GB/s",
+           roofline ? "  roof  %roof" : "");
+    for (int f = 0; f < func_counter; f++) {
+        const char *desc = func_list[f].description;
+        if (filter != NULL && strstr(desc, filter) == NULL) {
+            continue;
+        }
+
+        memset(B, 0, bytes);
+        func_list[f].func_ptr(M, N, (double(*)[M])A, (double(*)[N])B, tmp);
+        if (memcmp(B, ref, bytes) != 0) {
+            printf("  %-40s INCORRECT\n", desc);
+            continue;
+        }
+
+        for (int c = 0; c < 2; c++) {
+            bool cold = c == 1;
+            if ((cold && !run_cold) || (!cold && !run_warm)) {
+                continue;
+            }
+            const char *mode = cold ? "cold" : "warm";
+
+            bench_result_t r;
+            bench_one(f, M, N, A, B, cold, &r);
+            printf("  %-40.40s %-4s %12.3f %12.3f %12.3f %8.2f", desc, mode,
+                   r.best * 1e6, r.median * 1e6, r.p95 * 1e6, r.gbps);
+            double fraction = 0;
+            if (roofline) {
+                const roof_t *roof = roof_for(2 * bytes, cold);
+                fraction = r.gbps / roof->copy;
+                printf("  %-4s %5.1f%%", roof->name, fraction * 100.0);
+            }
+            double base = baseline_median(desc, M, N, mode, placement);
+            if (base > 0) {
+                printf("  %+.1f%%", (base / r.median - 1.0) * 100.0);
+            }
+            printf("\n");
+
+            if (csv != NULL) {
+                fprintf(csv,
+                        "%s,%zu,%zu,%s,%s,%d,%.9f,%.9f,%.9f,%.3f,%.4f\n",
+                        desc, M, N, mode, placement, reps, r.best, r.median,
+                        r.p95, r.gbps, fraction);
+            }
+        }
+    }
+
+    allocFree(&region);
+    free(ref);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const char *csv_path = NULL;
+    bool kinds[ALLOC_NUM_KINDS] = {false};
+    bool any_kind = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hRr:w:m:f:a:O:o:c:")) != -1) {
+        switch (opt) {
+        case 'R':
+            roofline = true;
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'w':
+            warmups = atoi(optarg);
+            break;
+        case 'm':
+            run_warm = strcmp(optarg, "cold") != 0;
+            run_cold = strcmp(optarg, "warm") != 0;
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'a': {
+            alloc_kind_t kind;
+            if (strcmp(optarg, "all") == 0) {
+                for (int k = 0; k < ALLOC_NUM_KINDS; k++) {
+                    kinds[k] = true;
+                }
+            } else if (allocKindParse(optarg, &kind)) {
+                kinds[kind] = true;
+            } else {
+                printf("Invalid placement: %s\n", optarg);
+                return 1;
+            }
+            any_kind = true;
+            break;
+        }
+        case 'O':
+            offset = (size_t)atol(optarg);
+            break;
+        case 'o':
+            csv_path = optarg;
+            break;
+        case 'c':
+            if (!load_baseline(optarg)) {
+                return 1;
+            }
+            break;
+        case 'h':
+            printHelpMessage();
+            return 0;
+        default:
+            printf("Invalid input.\n");
+            printHelpMessage();
+            return 1;
+        }
+    }
+    if (!any_kind) {
+        kinds[ALLOC_MALLOC] = true;
+    }
+    if (reps <= 0 || warmups < 0 || offset % sizeof(double) != 0) {
+        printf("Invalid input.\n");
+        printHelpMessage();
+        return 1;
+    }
+    // Read once by verifyMode(), so this must precede the first transpose
+    setenv("TRANS_VERIFY", "off", 1);
+
+    size_t shapes[BENCH_MAX_SHAPES][2] = {{64, 64}, {1024, 1024}, {4096, 4096}};
+    size_t num_shapes = 3;
+    if (optind < argc) {
+        num_shapes = 0;
+        for (int i = optind; i < argc && num_shapes < BENCH_MAX_SHAPES; i++) {
+            size_t M, N;
+            if (sscanf(argv[i], "%zux%zu", &M, &N) != 2 || M == 0 || N == 0 ||
+                M > MAXN || N > MAXN) {
+                printf("Invalid shape: %s\n", argv[i]);
+                return 1;
+            }
+            shapes[num_shapes][0] = M;
+            shapes[num_shapes][1] = N;
+            num_shapes++;
+        }
+    }
+
+    if (csv_path != NULL) {
+        csv = fopen(csv_path, "w");
+        if (csv == NULL) {
+            printf("File opening error.\n");
+            return 1;
+        }
+        fprintf(csv, "function,M,N,mode,placement,reps,best_s,median_s,"
+                     "p95_s,gbps,roof\n");
+    }
+
+    registerFunctions();
+    if (roofline && !measure_roofs()) {
+        return 1;
+    }
+
+    for (size_t s = 0; s < num_shapes; s++) {
+        for (int k = 0; k < ALLOC_NUM_KINDS; k++) {
+            if (kinds[k] && !bench_shape(shapes[s][0], shapes[s][1],
+                                         (alloc_kind_t)k, kinds)) {
+                return 1;
+            }
+        }
+    }
+
+    if (csv != NULL) {
+        fclose(csv);
+    }
+    free(baseline);
+    return 0;
+}
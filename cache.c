@@ -4,26 +4,53 @@
  */
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #include "cache.h"
+#include "pool.h"
+
+/** @brief Rows of a matrix filled by one pool task in initMatrix() */
+#define INIT_ROWS 64
+
+/** @brief Doubles copied by one pool task in copyMatrix() */
+#define COPY_CHUNK ((size_t)1 << 16)
+
+/** @brief Slots in the table of memoized dispatch decisions */
+#define DISPATCH_MEMO_SLOTS 256
+
+/** @brief Largest alignment, in bytes, that dispatch decisions distinguish */
+#define DISPATCH_MAX_ALIGN 4096
+
+/** @brief SplitMix64 increment, also used to separate the A and B streams */
+#define SPLITMIX_GAMMA 0x9e3779b97f4a7c15ULL
 
 trans_func_t func_list[MAX_TRANS_FUNCS];
 int func_counter = 0;
 
 /**
- * @brief Store a summary of the cache simulation statistics.
+ * @brief Print the cache simulation statistics without storing them.
  *
- * @param[in] stats The simulation statistics to be stored
+ * @param[in] stats The simulation statistics to be printed
  */
-void printSummary(const csim_stats_t *stats) {
+void printStats(const csim_stats_t *stats) {
     printf("hits:%ld misses:%ld evictions:%ld dirty_bytes_in_cache:%ld "
            "dirty_bytes_evicted:%ld\n",
            stats->hits, stats->misses, stats->evictions, stats->dirty_bytes,
            stats->dirty_evictions);
+}
+
+/**
+ * @brief Store a summary of the cache simulation statistics.
+ *
+ * @param[in] stats The simulation statistics to be stored
+ */
+void printSummary(const csim_stats_t *stats) {
+    printStats(stats);
 
     FILE *output_fp = fopen(".csim_results", "w");
     if (output_fp == NULL) {
@@ -64,28 +91,92 @@ bool loadSummary(csim_stats_t *stats) {
 }
 
 /**
- * @brief Initialize the given matrices
+ * @brief Struct representing one initMatrix() or copyMatrix() job
  */
-void initMatrix(size_t M, size_t N, double A[N][M], double B[M][N]) {
-    size_t i, j;
-    srand((unsigned int)time(NULL));
-    for (i = 0; i < N; i++) {
-        for (j = 0; j < M; j++) {
-            /* Initialize with data that can't be represented as int or float */
-            A[i][j] = (double)rand() / 8.0 + 1e10;
-            B[j][i] = (double)rand() / 8.0 + 1e10;
+typedef struct {
+    size_t M;          // width of A
+    size_t N;          // height of A
+    double *A;         // matrix filled or copied to
+    double *B;         // second matrix filled, or the copy source
+    uint64_t seed;     // seed of the A stream
+} matrix_job_t;
+
+/**
+ * @brief The n-th output of the SplitMix64 stream started at seed.
+ *
+ * Every output depends only on seed and n, so any slice of a matrix can
+ * be filled independently of the others, on any thread.
+ */
+static inline uint64_t splitmix(uint64_t seed, uint64_t n) {
+    uint64_t z = seed + (n + 1) * SPLITMIX_GAMMA;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Fills INIT_ROWS rows of A and of B.
+ */
+static void init_task(void *arg, size_t task) {
+    const matrix_job_t *job = arg;
+    size_t M = job->M;
+    size_t N = job->N;
+    uint64_t seed_b = job->seed ^ SPLITMIX_GAMMA;
+
+    /* Initialize with data that can't be represented as int or float */
+    for (size_t i = task * INIT_ROWS; i < (task + 1) * INIT_ROWS; i++) {
+        if (i < N) {
+            for (size_t j = 0; j < M; j++) {
+                uint64_t n = (uint64_t)(i * M + j);
+                job->A[n] = (double)(splitmix(job->seed, n) >> 33) / 8.0 + 1e10;
+            }
+        }
+        if (i < M) {
+            for (size_t j = 0; j < N; j++) {
+                uint64_t n = (uint64_t)(i * N + j);
+                job->B[n] = (double)(splitmix(seed_b, n) >> 33) / 8.0 + 1e10;
+            }
         }
     }
 }
 
+/**
+ * @brief Initialize the given matrices from seed.
+ *
+ * The contents depend only on M, N and seed, not on the number of threads
+ * filling them.
+ */
+void initMatrixSeeded(size_t M, size_t N, double A[N][M], double B[M][N],
+                      unsigned long seed) {
+    matrix_job_t job = {M, N, &A[0][0], &B[0][0], seed};
+    size_t rows = M > N ? M : N;
+    poolRun((rows + INIT_ROWS - 1) / INIT_ROWS, init_task, &job);
+}
+
+/**
+ * @brief Initialize the given matrices
+ */
+void initMatrix(size_t M, size_t N, double A[N][M], double B[M][N]) {
+    initMatrixSeeded(M, N, A, B, INIT_SEED);
+}
+
+/**
+ * @brief Copies COPY_CHUNK doubles of the matrix.
+ */
+static void copy_task(void *arg, size_t task) {
+    const matrix_job_t *job = arg;
+    size_t total = job->M * job->N;
+    size_t start = task * COPY_CHUNK;
+    size_t count = total - start < COPY_CHUNK ? total - start : COPY_CHUNK;
+    memcpy(job->A + start, job->B + start, count * sizeof(double));
+}
+
 /**
  * @brief Make a copy of a matrix
  */
 void copyMatrix(size_t M, size_t N, double Adst[N][M], double Asrc[N][M]) {
-    size_t i, j;
-    for (i = 0; i < N; i++)
-        for (j = 0; j < M; j++)
-            Adst[i][j] = Asrc[i][j];
+    matrix_job_t job = {M, N, &Adst[0][0], &Asrc[0][0], 0};
+    poolRun((M * N + COPY_CHUNK - 1) / COPY_CHUNK, copy_task, &job);
 }
 
 /**
@@ -108,7 +199,156 @@ void correctTrans(size_t M, size_t N, double A[N][M], double B[M][N]) {
 void registerTransFunction(void (*trans)(size_t M, size_t N, double[N][M],
                                          double[M][N], double *T),
                            const char *desc) {
+    static const trans_caps_t any = {0};
+    registerTransKernel(trans, desc, &any);
+}
+
+/*
+ * @brief Add the given trans function, and what it handles, into the list
+ */
+void registerTransKernel(void (*trans)(size_t M, size_t N, double[N][M],
+                                       double[M][N], double *T),
+                         const char *desc, const trans_caps_t *caps) {
+    if (func_counter == MAX_TRANS_FUNCS) {
+        fprintf(stderr, "Error: too many transpose functions, ignoring %s\n",
+                desc);
+        return;
+    }
     func_list[func_counter].func_ptr = trans;
     func_list[func_counter].description = desc;
+    func_list[func_counter].caps = *caps;
     func_counter++;
 }
+
+/** @brief TRANS_ISA_* bits TRANS_ISA_ENV allows; all unless it says less */
+static unsigned isa_allowed = TRANS_ISA_AVX2 | TRANS_ISA_AVX512;
+static pthread_once_t isa_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Reads TRANS_ISA_ENV into isa_allowed.
+ */
+static void read_isa(void) {
+    const char *env = getenv(TRANS_ISA_ENV);
+    if (env == NULL) {
+        return;
+    }
+    if (strcmp(env, "scalar") == 0) {
+        isa_allowed = 0;
+    } else if (strcmp(env, "avx2") == 0) {
+        isa_allowed = TRANS_ISA_AVX2;
+    }
+}
+
+/**
+ * @brief Checks if the running CPU has every TRANS_ISA_* bit in isa, and
+ *        TRANS_ISA_ENV allows them.
+ *
+ * The environment is read once, on the first call.
+ */
+bool transIsaSupported(unsigned isa) {
+    pthread_once(&isa_once, read_isa);
+    if ((isa & ~isa_allowed) != 0)
+        return false;
+#if defined(__x86_64__) && defined(__GNUC__)
+    if ((isa & TRANS_ISA_AVX2) && !__builtin_cpu_supports("avx2"))
+        return false;
+    if ((isa & TRANS_ISA_AVX512) && !__builtin_cpu_supports("avx512f"))
+        return false;
+    return true;
+#else
+    return isa == 0;
+#endif
+}
+
+/**
+ * @brief Checks if a kernel declared it handles this call.
+ *
+ * @param[in] caps  What the kernel handles
+ * @param[in] M     Width of A
+ * @param[in] N     Height of A
+ * @param[in] align Largest power of two dividing both &A and &B, at most
+ *                  DISPATCH_MAX_ALIGN
+ */
+static bool eligible(const trans_caps_t *caps, size_t M, size_t N,
+                     size_t align) {
+    size_t elems = M * N;
+    if (caps->cost == NULL || elems < caps->min_elems ||
+        (caps->max_elems != 0 && elems > caps->max_elems))
+        return false;
+    if (caps->m_multiple > 1 && M % caps->m_multiple != 0)
+        return false;
+    if (caps->n_multiple > 1 && N % caps->n_multiple != 0)
+        return false;
+    if (caps->square && M != N)
+        return false;
+    if (caps->pow2 && ((M & (M - 1)) != 0 || (N & (N - 1)) != 0))
+        return false;
+    if (caps->align > align)
+        return false;
+    return transIsaSupported(caps->isa);
+}
+
+/**
+ * @brief Struct representing one memoized dispatch decision
+ */
+typedef struct {
+    size_t M;
+    size_t N;
+    size_t align;   // alignment class of A and B
+    int generation; // func_counter when decided, 0 for an empty slot
+    int choice;     // index in func_list, -1 if nothing was eligible
+} dispatch_memo_t;
+
+static dispatch_memo_t memo[DISPATCH_MEMO_SLOTS];
+static pthread_mutex_t memo_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Index in func_list of the kernel dispatchTrans() would run.
+ *
+ * The eligible kernel with the lowest cost hint wins; ties go to the one
+ * registered first. Decisions are remembered per shape and alignment class
+ * until another function is registered.
+ *
+ * @return The index, or -1 if no registered kernel accepts the call
+ */
+int dispatchChoice(size_t M, size_t N, const double *A, const double *B) {
+    uintptr_t bits = (uintptr_t)A | (uintptr_t)B | DISPATCH_MAX_ALIGN;
+    size_t align = (size_t)(bits & -bits);
+    size_t slot = (M * 31 + N * 17 + align) % DISPATCH_MEMO_SLOTS;
+
+    pthread_mutex_lock(&memo_lock);
+    dispatch_memo_t *m = &memo[slot];
+    if (m->generation != func_counter || m->M != M || m->N != N ||
+        m->align != align) {
+        int best = -1;
+        double best_cost = 0;
+        for (int f = 0; f < func_counter; f++) {
+            const trans_caps_t *caps = &func_list[f].caps;
+            if (!eligible(caps, M, N, align))
+                continue;
+            double cost = caps->cost(M, N);
+            if (best < 0 || cost < best_cost) {
+                best = f;
+                best_cost = cost;
+            }
+        }
+        *m = (dispatch_memo_t){M, N, align, func_counter, best};
+    }
+    int choice = m->choice;
+    pthread_mutex_unlock(&memo_lock);
+    return choice;
+}
+
+/**
+ * @brief Transposes A into B with the cheapest eligible kernel.
+ *
+ * @return False, without touching B, if no registered kernel accepts the call
+ */
+bool dispatchTrans(size_t M, size_t N, double A[N][M], double B[M][N],
+                   double *tmp) {
+    int f = dispatchChoice(M, N, &A[0][0], &B[0][0]);
+    if (f < 0)
+        return false;
+    func_list[f].func_ptr(M, N, A, B, tmp);
+    return true;
+}
@@ -20,6 +20,9 @@ typedef struct {
     unsigned long dirty_evictions; // number of bytes evicted from dirty lines
 } csim_stats_t;
 
+/** @brief Print the cache simulation statistics without storing them. */
+void printStats(const csim_stats_t *stats);
+
 /** @brief Store a summary of the cache simulation statistics. */
 void printSummary(const csim_stats_t *stats);
 
@@ -67,12 +70,46 @@ bool loadSummary(csim_stats_t *stats);
  */
 #define TMPCOUNT 256
 
+/** @brief The CPU must support AVX2 */
+#define TRANS_ISA_AVX2 0x1
+
+/** @brief The CPU must support AVX-512F */
+#define TRANS_ISA_AVX512 0x2
+
+/**
+ * @brief Environment variable capping the instruction sets transposes use
+ *
+ * "scalar" allows none of the TRANS_ISA_* sets and "avx2" only AVX2, so
+ * results can be reproduced on hosts with wider vector units.
+ */
+#define TRANS_ISA_ENV "TRANS_ISA"
+
+/**
+ * @brief Struct representing the inputs a transpose function handles well
+ *
+ * Functions with a cost hint are candidates for dispatchTrans(); a zeroed
+ * struct, as registerTransFunction() stores, accepts everything but is
+ * never dispatched to.
+ */
+typedef struct {
+    size_t min_elems;  // smallest M * N accepted
+    size_t max_elems;  // largest M * N accepted, 0 for no limit
+    size_t m_multiple; // M must be a multiple of this, 0 or 1 for any
+    size_t n_multiple; // N must be a multiple of this, 0 or 1 for any
+    bool square;       // only M == N
+    bool pow2;         // only powers of two for M and N
+    size_t align;      // byte alignment A and B must have, 0 for any
+    unsigned isa;      // TRANS_ISA_* bits the CPU must support
+    double (*cost)(size_t M, size_t N); // relative cost, lower is better
+} trans_caps_t;
+
 /**
  * @brief Struct representing the execution state of a transpose function
  */
 typedef struct trans_func {
     void (*func_ptr)(size_t M, size_t N, double[N][M], double[M][N], double *);
     const char *description;
+    trans_caps_t caps;
 } trans_func_t;
 
 /* External variables defined in cache.c */
@@ -82,9 +119,16 @@ extern int func_counter;
 /* External function defined in trans.c */
 extern void registerFunctions(void);
 
+/** @brief Seed used by initMatrix() */
+#define INIT_SEED 0x5eed
+
 /** @brief Fills a matrix with data */
 void initMatrix(size_t M, size_t N, double A[N][M], double B[M][N]);
 
+/** @brief Fills a matrix with data generated from seed */
+void initMatrixSeeded(size_t M, size_t N, double A[N][M], double B[M][N],
+                      unsigned long seed);
+
 /** @brief Makes a copy of a matrix */
 void copyMatrix(size_t M, size_t N, double Adst[N][M], double Asrc[N][M]);
 
@@ -96,4 +140,19 @@ void registerTransFunction(void (*trans)(size_t M, size_t N, double[N][M],
                                          double[M][N], double *),
                            const char *desc);
 
+/** @brief Adds a transpose function that dispatchTrans() may pick */
+void registerTransKernel(void (*trans)(size_t M, size_t N, double[N][M],
+                                       double[M][N], double *),
+                         const char *desc, const trans_caps_t *caps);
+
+/** @brief Index in func_list of the kernel dispatchTrans() would run */
+int dispatchChoice(size_t M, size_t N, const double *A, const double *B);
+
+/** @brief Checks if the CPU has, and TRANS_ISA allows, every bit in isa */
+bool transIsaSupported(unsigned isa);
+
+/** @brief Transposes A into B with the cheapest eligible kernel */
+bool dispatchTrans(size_t M, size_t N, double A[N][M], double B[M][N],
+                   double *tmp);
+
 #endif /* CACHE_TOOLS_H */
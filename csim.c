@@ -6,13 +6,11 @@
  * This is an implementation of a cache simulator with command-line tool.
  * Follows LRU replacement policy when choosing which line to evict.
  * Follows a write-back, write allocate policy.
- * LRU is implemented using the "lastUsed" field.
- * When a line is used, its "lastUsed" is set to 0, all others in the set
- * are incremented by 1. The one being evicted is the one with the largest
- * "lastUsed".
+ * The cache itself is simulated by the engine in sim.c.
  *
  * Command-line usage:
- *   ./csim [-v] -s <s> -E <E> -b <b> -t <trace>
+ *   ./csim [-v] -s <s> -E <E> -b <b> [-I <s>,<E>,<b>] [-f <format>]
+ *          [-o <output> [-O <format>]] -t <trace>
  *   ./csim -h
  *
  * -h    Print this help message and exit
@@ -20,18 +18,37 @@
  * -s    <s> Number of set index bits (there are 2**s sets)
  * -b    <b> Number of block bits (there are 2**b blocks)
  * -E    <E> Number of lines per set (associativity)
- * -t    <trace> File name of the memory trace to process
+ * -I    <s>,<E>,<b> Also simulate instruction fetches, in a separate
+ *       instruction cache of this geometry
+ * -f    <format> Format of the trace: lackey (default), drmemtrace or
+ *       champsim, decoded by reader.c
+ * -o    <output> Also write the misses and dirty evictions to a reduced
+ *       trace, to replay through larger caches. With - the trace goes to
+ *       stdout, the verbose lines and summary go to stderr and the
+ *       summary is not stored, leaving .csim_results to the next stage
+ * -O    <format> Format of the reduced trace: lackey (default) or
+ *       drmemtrace
+ * -t    <trace> File name of the memory trace to process, or - for stdin
  *
  * Trace files can be found in the traces/csim/ subdirectory.
- * Each line in the trace file must be in the format: Op Addr,Size.
+ * Each line in a lackey trace file must be in the format: Op Addr,Size,
+ * optionally preceded by spaces as in valgrind lackey output.
  *
  * Op: denotes the type of memory access. It can be either L for a load,
- *     or S for a store.
+ *     S for a store, M for a modify (a load and a store to the same
+ *     address) or I for an instruction fetch. Instruction fetches are
+ *     skipped unless -I is given; their statistics are printed on a
+ *     separate line and not stored with the data cache summary.
  * Addr: gives the memory address to be accessed. It should be a 64-bit
  *       hexadecimal number, without a leading 0x.
  * Size: gives the number of bytes to be accessed at Addr. It should be
  *       a small, positive decimal number.
  *
+ * The reduced trace holds what the next cache level sees: each miss as a
+ * load of its whole block (an I record for instruction misses), since the
+ * cache allocates on writes, and each dirty eviction as a store of the
+ * victim block, right after the miss that caused it.
+ *
  * @version 0.1
  * @date 2022-02-21
  *
@@ -39,41 +56,54 @@
  */
 
 #include "cache.h"
+#include "reader.h"
+#include "sim.h"
 #include <getopt.h>
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-typedef struct {
-    int valid;           // 1 if the line is being used
-    long tag;            // Used to match line
-    unsigned long dirty; // 1 if the block is modified but not yet written back
-    long lastUsed;       // Used to implement LRU replacement policy
-} cacheLine;
-
 // Globals set by command line args
 int s = -1;               // Set index
 int E = -1;               // Number of lines per set
 int b = -1;               // Offset
 bool verbose = false;     // Print trace if true
-FILE *traceFile = NULL;
-cacheLine **cache = NULL;
-csim_stats_t stats;       // Output stats
+const char *tracePath = NULL;
+reader_format_t traceFormat = READER_LACKEY;
+sim_cache_t cache;        // Simulated cache and its stats
+int iset = -1;            // Geometry of the instruction cache, if any
+int iassoc = -1;
+int iblock = -1;
+sim_cache_t icache;       // Simulated instruction cache and its stats
+const char *outputPath = NULL;
+reader_format_t outputFormat = READER_LACKEY;
+reader_t output;          // Reduced trace of misses and dirty evictions
+bool piped = false;       // Output is stdout, so the summary is not stored
+
+/** @brief Data access of each op character, or 0 for other records */
+static const char data_op[256] = {['L'] = 'L', ['S'] = 'S', ['M'] = 'M'};
 
 /**
  * @brief Print help message when -h option is called or param error.
  *
  */
 void printHelpMessage() {
-    printf("Usage: ./csim [-v] -s <s> -E <E> -b <b> -t <trace>\n");
+    printf("Usage: ./csim [-v] -s <s> -E <E> -b <b> [-I <s>,<E>,<b>] "
+           "[-f <format>]\n");
+    printf("              [-o <output> [-O <format>]] -t <trace>\n");
     printf("       ./csim -h\n\n");
     printf("  -h            Print this help message and exit\n");
     printf("  -v            Verbose mode: report effects of each memory\n");
     printf("  -s <s>        Number of set index bits (there are 2**s sets)\n");
     printf("  -b <b>        Number of block bits (there are 2**b blocks)\n");
     printf("  -E <E>        Number of lines per set (associativity)\n");
+    printf("  -I <s>,<E>,<b> Simulate instruction fetches in a separate "
+           "cache\n");
+    printf("  -f <format>   Trace format: lackey, drmemtrace or champsim\n");
+    printf("  -o <output>   Write misses and dirty evictions to a trace, or\n");
+    printf("                to stdout for - (the summary then goes to stderr)\n");
+    printf("  -O <format>   Output format: lackey or drmemtrace\n");
     printf("  -t <trace>    File name of the memory trace to process\n");
 }
 
@@ -85,7 +115,7 @@ void printHelpMessage() {
  */
 void parseArgument(int argc, char *argv[]) {
     int opt;
-    while ((opt = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+    while ((opt = getopt(argc, argv, "hvs:E:b:I:f:o:O:t:")) != -1) {
         switch (opt) {
         case 's':
             s = atoi(optarg);
@@ -96,13 +126,33 @@ void parseArgument(int argc, char *argv[]) {
         case 'b':
             b = atoi(optarg);
             break;
-        case 't':
-            traceFile = fopen(optarg, "r");
-            if (traceFile == NULL) {
-                printf("File opening error.\n");
+        case 'I':
+            if (sscanf(optarg, "%d,%d,%d", &iset, &iassoc, &iblock) != 3) {
+                printf("Invalid input.\n");
+                printHelpMessage();
+                exit(1);
+            }
+            break;
+        case 'f':
+            if (!readerFormatParse(optarg, &traceFormat)) {
+                printf("Invalid input.\n");
+                printHelpMessage();
+                exit(1);
+            }
+            break;
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 'O':
+            if (!readerFormatParse(optarg, &outputFormat)) {
+                printf("Invalid input.\n");
+                printHelpMessage();
                 exit(1);
             }
             break;
+        case 't':
+            tracePath = optarg;
+            break;
         case 'h':
             printHelpMessage();
             exit(0);
@@ -120,7 +170,7 @@ void parseArgument(int argc, char *argv[]) {
     // Not all of -s, -b, -E, and -t were supplied or
     // The value for -s, -b, or -E is not a positive integer, or is too large to
     // make sense.
-    if (s < 0 || E <= 0 || b < 0 || s + b > 64) {
+    if (s < 0 || E <= 0 || b < 0 || s + b > 64 || tracePath == NULL) {
         printf("Invalid input.\n");
         printHelpMessage();
         exit(1);
@@ -133,163 +183,105 @@ void parseArgument(int argc, char *argv[]) {
  * @brief Initialize the cache.
  */
 void init() {
-    int S = (int)pow(2, s);
-    cache = (cacheLine **)malloc(sizeof(cacheLine *) * (unsigned long)S);
-    if (cache == NULL) {
+    if (!simInit(&cache, s, E, b)) {
         printf("Invalid set memory\n");
         exit(1);
     }
-
-    for (int i = 0; i < S; i++) {
-        cache[i] = (cacheLine *)malloc(sizeof(cacheLine) * (unsigned long)E);
-        if (cache[i] == NULL) {
-            printf("Invalid line memory\n");
+    if (iset >= 0 && !simInit(&icache, iset, iassoc, iblock)) {
+        printf("Invalid instruction cache\n");
+        exit(1);
+    }
+    if (outputPath != NULL &&
+        !readerCreate(&output, outputPath, outputFormat)) {
+        printf("Output opening error.\n");
+        exit(1);
+    }
+    // With -o -, the reduced trace keeps the stdout descriptor and the
+    // report (verbose lines and summary) moves to stderr, so that the trace
+    // can be piped into another csim -t -. Only the last csim of such a
+    // pipe stores its summary in .csim_results
+    if (output.fp == stdout) {
+        piped = true;
+        int trace_fd = dup(STDOUT_FILENO);
+        if (trace_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 ||
+            (output.fp = fdopen(trace_fd, "wb")) == NULL) {
+            fprintf(stderr, "Output opening error.\n");
             exit(1);
         }
-        // Set all fields to 0
-        for (int j = 0; j < E; j++) {
-            cache[i][j].valid = 0;
-            cache[i][j].lastUsed = 0;
-            cache[i][j].dirty = 0;
-        }
     }
     return;
 }
 
 /**
- * @brief Update "lastUsed" field of the cache line.
+ * @brief Appends what the next level sees of one access to the output.
  *
- * @param set Set index of the cache line being updated.
- * @param offset Block offset of the cache line being updated.
+ * @param level  The cache accessed
+ * @param addr   Address accessed
+ * @param fill   Op of a miss: 'L' for data, 'I' for instructions
+ * @param result simAccess() result bits
+ * @param victim Address of the evicted block, if any
  */
-void updateLastUsed(long set, long offset) {
-    cache[set][offset].lastUsed = 0;
-    // Fields "lastUsed" in all the other lines are incremented by 1
-    for (int i = 0; i < E; i++) {
-        if (i != offset) {
-            cache[set][i].lastUsed++;
-        }
+static void emit(const sim_cache_t *level, long addr, char fill, int result,
+                 unsigned long victim) {
+    int block = 1 << level->b;
+    if (result & SIM_MISS) {
+        reader_record_t miss = {(unsigned long)addr & ~(unsigned long)(block - 1),
+                                block, fill};
+        readerPut(&output, &miss);
     }
-}
-
-/**
- * @brief Find the least recently used cache line using field "lastUsed".
- *
- * @param set Set index of the cache line being updated.
- * @return int
- */
-int findLeastRecentlyUsed(long set) {
-    int maxIndex = 0;
-    for (int i = 0; i < E; i++) {
-        if (cache[set][i].lastUsed > cache[set][maxIndex].lastUsed) {
-            maxIndex = i;
-        }
+    if (result & SIM_DIRTY_EVICT) {
+        reader_record_t writeback = {victim, block, 'S'};
+        readerPut(&output, &writeback);
     }
-    return maxIndex;
 }
 
 /**
- * @brief Judge if the operation results in cache miss.
+ * @brief Load, store or modify data operation read from the trace file.
  *
- * @param set Set index of the target cache line.
- * @param tag Used to match cache line.
+ * @param addr Gives the memory address to be accessed.
  * @param operation Denotes the type of memory access.
- * @return true if it causes a cache miss.
- * @return false if it causes a cache hit.
  */
-bool isMiss(long set, long tag, int operation) {
-    bool isMiss = true;
-    for (int i = 0; i < E; i++) {
-        // If it's a cache hit, update "lastUsed"
-        if (cache[set][i].valid == 1 && cache[set][i].tag == tag) {
-            isMiss = false;
-            updateLastUsed(set, i);
-
-            if (operation == 'S' && cache[set][i].dirty == 0) {
-                cache[set][i].dirty = 1;
-                stats.dirty_bytes += (unsigned long)pow(2, b);
-            }
-            break;
-        }
+void updateData(long addr, char operation) {
+    unsigned long victim = 0;
+    int result = simAccess(&cache, (unsigned long)addr, operation, &victim);
+    if (output.fp != NULL) {
+        emit(&cache, addr, 'L', result, victim);
     }
-    return isMiss;
-}
 
-/**
- * @brief Load bytes from memory to cache
- *
- * @param set Set index of the target cache line.
- * @param tag Used to match cache line.
- * @param operation Denotes the type of memory access.
- * @return true if the set is full.
- * @return false if the set is not full.
- */
-bool updateCache(long set, long tag, char operation) {
-    bool isFull = true;
-    int i;
-    for (i = 0; i < E; i++) {
-        if (cache[set][i].valid == 0) {
-            isFull = false;
-            cache[set][i].valid = 1;
-            cache[set][i].tag = tag;
-            cache[set][i].dirty = 0;
-            updateLastUsed(set, i);
-            break;
+    if (verbose) {
+        if (result & SIM_HIT) {
+            printf("hit");
         }
-    }
-
-    // Index of the cache line being updated
-    int index = i;
-
-    // Evict the line with largest "lastUsed"
-    if (isFull) {
-        int evicted = findLeastRecentlyUsed(set);
-        cache[set][evicted].valid = 1;
-        cache[set][evicted].tag = tag;
-        if (cache[set][evicted].dirty) {
-            stats.dirty_evictions += (unsigned long)pow(2, b);
-            stats.dirty_bytes -= (unsigned long)pow(2, b);
-            cache[set][evicted].dirty = 0;
+        if (result & SIM_MISS) {
+            printf("miss ");
+        }
+        if (result & SIM_EVICT) {
+            printf("eviction");
+        }
+        // The store of a modify always hits; "miss " already ends in a space
+        if (operation == 'M') {
+            bool spaced = (result & SIM_MISS) && !(result & SIM_EVICT);
+            printf(spaced ? "hit" : " hit");
         }
-        updateLastUsed(set, evicted);
-        index = evicted;
-    }
-
-    if (operation == 'S') {
-        cache[set][index].dirty = 1;
-        stats.dirty_bytes += (unsigned long)pow(2, b);
     }
-
-    return isFull;
+    return;
 }
 
 /**
- * @brief Load or save data operation read from the trace file.
+ * @brief Instruction fetch read from the trace file.
  *
- * @param addr Gives the memory address to be accessed.
- * @param operation Denotes the type of memory access.
+ * @param addr Gives the address of the instruction.
  */
-void updateData(long addr, char operation) {
-    long set = addr >> b & ((1 << s) - 1);
-    long tag = addr >> (s + b);
-
-    if (isMiss(set, tag, operation)) {
-        stats.misses++;
-        if (verbose) {
-            printf("miss ");
-        }
+void updateInstruction(long addr) {
+    unsigned long victim = 0;
+    int result = simAccess(&icache, (unsigned long)addr, 'L', &victim);
+    if (output.fp != NULL) {
+        emit(&icache, addr, 'I', result, victim);
+    }
 
-        if (updateCache(set, tag, operation)) {
-            stats.evictions++;
-            if (verbose) {
-                printf("eviction");
-            }
-        }
-    } else {
-        stats.hits++;
-        if (verbose) {
-            printf("hit");
-        }
+    if (verbose) {
+        printf("%s%s", result & SIM_HIT ? "hit" : "miss ",
+               result & SIM_EVICT ? "eviction" : "");
     }
     return;
 }
@@ -297,29 +289,54 @@ void updateData(long addr, char operation) {
 int main(int argc, char *argv[]) {
     parseArgument(argc, argv);
     init();
-    char buf[20];
-    char operation;
-    long addr;
-    int size;
+    reader_t reader;
+    if (!readerOpen(&reader, tracePath, traceFormat)) {
+        printf("File opening error.\n");
+        exit(1);
+    }
+    reader_record_t *records = malloc(READER_BATCH * sizeof(reader_record_t));
+    if (records == NULL) {
+        printf("Invalid record memory\n");
+        exit(1);
+    }
 
-    // Read trace file and parse line by line
-    while (fgets(buf, sizeof(buf), traceFile) != NULL) {
-        const char *delim = " ,";
-        operation = buf[0];
-        strtok(buf, delim);
-        addr = strtol(strtok(NULL, delim), NULL, 16);
-        size = atoi(strtok(NULL, delim));
-        if (verbose) {
-            printf("%c %lx,%d ", operation, addr, size);
-        }
-        if (operation == 'L' | operation == 'S') {
-            updateData(addr, operation);
-        }
-        if (verbose) {
-            printf("\n");
+    // Read the trace a batch of records at a time
+    size_t n;
+    while ((n = readerNext(&reader, records, READER_BATCH)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            char operation = records[i].op;
+            long addr = (long)records[i].addr;
+            if (verbose) {
+                printf("%c %lx,%d ", operation, addr, records[i].size);
+            }
+            // Loads and stores take the first branch every time
+            char data = data_op[(unsigned char)operation];
+            if (data != 0) {
+                updateData(addr, data);
+            } else if (operation == 'I' && icache.lines != NULL) {
+                updateInstruction(addr);
+            }
+            if (verbose) {
+                printf("\n");
+            }
         }
     }
+    free(records);
+    readerClose(&reader);
+    if (output.fp != NULL) {
+        readerClose(&output);
+    }
 
-    printSummary(&stats);
+    if (piped) {
+        printStats(&cache.stats);
+    } else {
+        printSummary(&cache.stats);
+    }
+    if (icache.lines != NULL) {
+        printf("instruction hits:%ld misses:%ld evictions:%ld\n",
+               icache.stats.hits, icache.stats.misses, icache.stats.evictions);
+        simFree(&icache);
+    }
+    simFree(&cache);
     return 0;
 }
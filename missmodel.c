@@ -0,0 +1,189 @@
+/**
+ * @file missmodel.c
+ * @author Yifan Gu
+ * @brief Estimates transpose and copy misses analytically
+ *
+ * For each shape, builds the loop nests of the untiled transpose, the
+ * tiled transpose and a row-by-row copy, and prints the misses the model in
+ * model.c expects for A and for B, without simulating every access. It
+ * then screens every power-of-two tile edge dividing the shape and names
+ * the one with the fewest expected misses.
+ *
+ * Command-line usage:
+ *   ./missmodel [-s <s> -E <E> -b <b>] [-t <tile>] [-v] <M>x<N> ...
+ *   ./missmodel -h
+ *
+ * -h    Print this help message and exit
+ * -s    <s> Number of set index bits (default TEST_LOG_SET)
+ * -E    <E> Number of lines per set (default TEST_ASSOC)
+ * -b    <b> Number of block bits (default TEST_LOG_BLOCK)
+ * -t    <tile> Tile edge of the tiled transpose (default one block of
+ *       doubles)
+ * -v    Also simulate every access and print the error of the model, per
+ *       array and in total
+ *
+ * As in the reference driver, A starts at 0 and B right after it.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cache.h"
+#include "model.h"
+
+/** @brief Largest tile edge screened */
+#define MAX_SCREEN_TILE 256
+
+/**
+ * @brief Print help message when -h option is called or param error.
+ */
+static void printHelpMessage(void) {
+    printf("Usage: ./missmodel [-s <s> -E <E> -b <b>] [-t <tile>] [-v] "
+           "<M>x<N> ...\n");
+    printf("       ./missmodel -h\n\n");
+    printf("  -h            Print this help message and exit\n");
+    printf("  -s <s>        Number of set index bits (there are 2**s sets)\n");
+    printf("  -E <E>        Number of lines per set (associativity)\n");
+    printf("  -b <b>        Number of block bits (there are 2**b blocks)\n");
+    printf("  -t <tile>     Tile edge of the tiled transpose\n");
+    printf("  -v            Validate the model against the simulator\n");
+}
+
+/**
+ * @brief Returns the current time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Relative error of an estimate against the simulated count, in %.
+ */
+static double error_of(double model, unsigned long actual) {
+    return actual > 0 ? 100 * (model - (double)actual) / (double)actual : 0;
+}
+
+/**
+ * @brief Prints the expected misses of one nest, and optionally the
+ *        simulated ones.
+ */
+static void report(const char *label, const model_nest_t *nest, int s, int E,
+                   int b, bool validate) {
+    double misses[MODEL_MAX_REFS];
+    double start = now();
+    double total = modelMisses(nest, s, E, b, misses);
+    double elapsed = now() - start;
+
+    printf("  %-12s model A %10.0f B %10.0f total %10.0f (%.2f ms)\n", label,
+           misses[0], misses[1], total, elapsed * 1e3);
+    if (!validate) {
+        return;
+    }
+
+    unsigned long simulated[MODEL_MAX_REFS];
+    start = now();
+    unsigned long actual = modelSimulate(nest, s, E, b, simulated);
+    elapsed = now() - start;
+    printf("  %-12s sim   A %10lu B %10lu total %10lu (%.2f ms)\n", "",
+           simulated[0], simulated[1], actual, elapsed * 1e3);
+    printf("  %-12s error A %+9.1f%% B %+9.1f%% total %+9.1f%%\n", "",
+           error_of(misses[0], simulated[0]), error_of(misses[1], simulated[1]),
+           error_of(total, actual));
+}
+
+int main(int argc, char *argv[]) {
+    int s = TEST_LOG_SET;
+    int E = TEST_ASSOC;
+    int b = TEST_LOG_BLOCK;
+    size_t tile = 0;
+    bool validate = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hs:E:b:t:v")) != -1) {
+        switch (opt) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            tile = (size_t)atol(optarg);
+            break;
+        case 'v':
+            validate = true;
+            break;
+        case 'h':
+            printHelpMessage();
+            return 0;
+        default:
+            printf("Invalid input.\n");
+            printHelpMessage();
+            return 1;
+        }
+    }
+    if (s < 0 || s > 20 || E <= 0 || b < 3 || b > 20 || optind == argc) {
+        printf("Invalid input.\n");
+        printHelpMessage();
+        return 1;
+    }
+    if (tile == 0) {
+        tile = ((size_t)1 << b) / sizeof(double);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        size_t M, N;
+        if (sscanf(argv[i], "%zux%zu", &M, &N) != 2 || M == 0 || N == 0 ||
+            M > MAXN || N > MAXN) {
+            printf("Invalid shape: %s\n", argv[i]);
+            return 1;
+        }
+        uintptr_t A = 0;
+        uintptr_t B = A + M * N * sizeof(double);
+
+        printf("%zux%zu: s=%d E=%d b=%d\n", M, N, s, E, b);
+        model_nest_t nest;
+        char label[32];
+        modelTranspose(&nest, M, N, A, B, 0);
+        report("basic", &nest, s, E, b, validate);
+        if (M % tile == 0 && N % tile == 0) {
+            snprintf(label, sizeof(label), "tile %zu", tile);
+            modelTranspose(&nest, M, N, A, B, tile);
+            report(label, &nest, s, E, b, validate);
+        }
+        modelCopy(&nest, M, N, A, B);
+        report("copy", &nest, s, E, b, validate);
+
+        // Screen the power-of-two tiles without simulating any of them
+        double misses[MODEL_MAX_REFS];
+        size_t best_tile = 1;
+        modelTranspose(&nest, M, N, A, B, 0);
+        double best = modelMisses(&nest, s, E, b, misses);
+        printf("  screen:");
+        for (size_t t = 2; t <= MAX_SCREEN_TILE; t *= 2) {
+            if (M % t != 0 || N % t != 0) {
+                continue;
+            }
+            modelTranspose(&nest, M, N, A, B, t);
+            double total = modelMisses(&nest, s, E, b, misses);
+            printf(" %zu:%.0f", t, total);
+            if (total < best) {
+                best = total;
+                best_tile = t;
+            }
+        }
+        printf("\n  best tile %zu: %.0f misses\n", best_tile, best);
+    }
+
+    return 0;
+}
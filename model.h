@@ -0,0 +1,60 @@
+/**
+ * @file model.h
+ * @brief Prototypes for the analytical cache-miss model of loop nests
+ */
+
+#ifndef MODEL_TOOLS_H
+#define MODEL_TOOLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Most loops in a modeled nest */
+#define MODEL_MAX_LOOPS 4
+
+/** @brief Most array references in a modeled nest */
+#define MODEL_MAX_REFS 4
+
+/**
+ * @brief Struct representing one affine array reference
+ *
+ * The reference accesses one double at base plus the sum over the loops of
+ * stride times the loop index.
+ */
+typedef struct {
+    const char *name;               // array name, for reports
+    uintptr_t base;                 // address at all loop indices zero
+    long stride[MODEL_MAX_LOOPS];   // bytes per iteration of each loop
+    char op;                        // 'L' for a load, 'S' for a store
+} model_ref_t;
+
+/**
+ * @brief Struct representing a perfect affine loop nest
+ *
+ * Loop 0 is the outermost. Every iteration of the innermost loop performs
+ * the references in order.
+ */
+typedef struct {
+    int num_loops;
+    size_t trips[MODEL_MAX_LOOPS]; // iterations of each loop
+    int num_refs;
+    model_ref_t refs[MODEL_MAX_REFS];
+} model_nest_t;
+
+/** @brief Builds the nest of a transpose of N x M A into B, tiled by tile */
+void modelTranspose(model_nest_t *nest, size_t M, size_t N, uintptr_t A,
+                    uintptr_t B, size_t tile);
+
+/** @brief Builds the nest of a row-by-row copy of N x M A into B */
+void modelCopy(model_nest_t *nest, size_t M, size_t N, uintptr_t A,
+               uintptr_t B);
+
+/** @brief Estimates the misses of each reference without simulating */
+double modelMisses(const model_nest_t *nest, int s, int E, int b,
+                   double misses[MODEL_MAX_REFS]);
+
+/** @brief Counts the misses of each reference by simulating every access */
+unsigned long modelSimulate(const model_nest_t *nest, int s, int E, int b,
+                            unsigned long misses[MODEL_MAX_REFS]);
+
+#endif /* MODEL_TOOLS_H */
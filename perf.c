@@ -0,0 +1,142 @@
+/**
+ * @file perf.c
+ * @brief Hardware performance counters through perf_event_open
+ *
+ * Each event is opened on its own, counting user-space work of the calling
+ * thread only, so one unsupported event does not take the others with it.
+ * Containers and hosts with a strict perf_event_paranoid often refuse every
+ * event; perfOpen() then returns false and callers carry on without counts.
+ * When the kernel multiplexes more events than the PMU has counters, the
+ * counts are scaled by the fraction of time each event was scheduled.
+ *
+ * @author Yifan Gu
+ */
+
+#define _GNU_SOURCE
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+/** @brief Generic cache event config: cache level, read access, miss */
+#define CACHE_READ_MISS(cache)                                                 \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) |                            \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/**
+ * @brief Struct representing how one event is requested from the kernel
+ */
+typedef struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} event_desc_t;
+
+static const event_desc_t events[PERF_NUM_EVENTS] = {
+    [PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    [PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+                           "instructions"},
+    [PERF_L1D_MISSES] = {PERF_TYPE_HW_CACHE,
+                         CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D),
+                         "L1D-misses"},
+    [PERF_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+                         "LLC-misses"},
+    [PERF_DTLB_MISSES] = {PERF_TYPE_HW_CACHE,
+                          CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB),
+                          "dTLB-misses"},
+};
+
+/**
+ * @brief Opens every counter the kernel allows.
+ *
+ * @param[out] pc Counters to open
+ *
+ * @return False if no counter could be opened, true otherwise
+ */
+bool perfOpen(perf_counters_t *pc) {
+    bool any = false;
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[e].type;
+        attr.config = events[e].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        pc->fd[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        pc->count[e] = 0;
+        any |= pc->fd[e] >= 0;
+    }
+    return any;
+}
+
+/**
+ * @brief Closes every counter.
+ */
+void perfClose(perf_counters_t *pc) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (pc->fd[e] >= 0) {
+            close(pc->fd[e]);
+            pc->fd[e] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Resets and starts every open counter.
+ */
+void perfStart(perf_counters_t *pc) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (pc->fd[e] >= 0) {
+            ioctl(pc->fd[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/**
+ * @brief Stops every open counter and reads the counts into pc->count.
+ */
+void perfStop(perf_counters_t *pc) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (pc->fd[e] >= 0) {
+            ioctl(pc->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        uint64_t value[3]; // count, time enabled, time running
+        pc->count[e] = 0;
+        if (pc->fd[e] < 0 ||
+            read(pc->fd[e], value, sizeof(value)) != sizeof(value)) {
+            continue;
+        }
+        if (value[2] > 0 && value[2] < value[1]) {
+            value[0] = (uint64_t)((double)value[0] * (double)value[1] /
+                                  (double)value[2]);
+        }
+        pc->count[e] = (unsigned long)value[0];
+    }
+}
+
+/**
+ * @brief Whether event was opened.
+ */
+bool perfAvailable(const perf_counters_t *pc, perf_event_t event) {
+    return pc->fd[event] >= 0;
+}
+
+/**
+ * @brief Short name of event.
+ */
+const char *perfEventName(perf_event_t event) {
+    return events[event].name;
+}
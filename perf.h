@@ -0,0 +1,49 @@
+/**
+ * @file perf.h
+ * @brief Prototypes for the hardware performance counters
+ */
+
+#ifndef PERF_TOOLS_H
+#define PERF_TOOLS_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Enum of the hardware events that can be counted
+ */
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_NUM_EVENTS
+} perf_event_t;
+
+/**
+ * @brief Struct representing one set of counters for the calling thread
+ */
+typedef struct {
+    int fd[PERF_NUM_EVENTS];                // -1 if the event is unavailable
+    unsigned long count[PERF_NUM_EVENTS];   // counts from the last perfStop()
+} perf_counters_t;
+
+/** @brief Opens every counter the kernel allows; false if none opened */
+bool perfOpen(perf_counters_t *pc);
+
+/** @brief Closes every counter */
+void perfClose(perf_counters_t *pc);
+
+/** @brief Resets and starts every open counter */
+void perfStart(perf_counters_t *pc);
+
+/** @brief Stops every open counter and reads the counts into pc->count */
+void perfStop(perf_counters_t *pc);
+
+/** @brief Whether event was opened */
+bool perfAvailable(const perf_counters_t *pc, perf_event_t event);
+
+/** @brief Short name of event */
+const char *perfEventName(perf_event_t event);
+
+#endif /* PERF_TOOLS_H */
@@ -0,0 +1,257 @@
+/**
+ * @file permute.c
+ * @brief Strided N-D axis permutation built on the 2-D transpose kernels
+ *
+ * A permutation is first simplified: axes of extent 1 are dropped, and axes
+ * that are adjacent in B and stay contiguous in both A and B are merged.
+ * What is left is lowered onto one of three inner operations, repeated over
+ * every index of the remaining outer axes:
+ *
+ *   copy       B's innermost axis is also A's unit-stride axis, so each
+ *              inner run is one memcpy.
+ *   transpose  B's innermost axis and A's unit-stride axis differ, so each
+ *              pair of them is a 2-D plane handed to transposeView().
+ *   generic    Neither layout has a unit-stride axis; elements are copied
+ *              one at a time along B's innermost axis.
+ *
+ * Large jobs are split over the thread pool along the outer axes.
+ *
+ * @author Yifan Gu
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "permute.h"
+#include "pool.h"
+#include "trans.h"
+
+/** @brief Jobs with fewer elements than this run on the calling thread */
+#define PERMUTE_PARALLEL_MIN ((size_t)1 << 16)
+
+/** @brief Inner operations that a permutation is lowered onto */
+typedef enum { PERMUTE_COPY, PERMUTE_TRANSPOSE, PERMUTE_GENERIC } inner_t;
+
+/**
+ * @brief Struct representing one axis of a permutation, in B's order
+ */
+typedef struct {
+    size_t ext; // number of indices along the axis
+    size_t sa;  // stride in A, in elements
+    size_t sb;  // stride in B, in elements
+} axis_t;
+
+/**
+ * @brief Struct representing a lowered permutation
+ */
+typedef struct {
+    const double *A;
+    double *B;
+    inner_t inner;              // operation applied at every outer index
+    axis_t row;                 // B's innermost axis
+    axis_t col;                 // A's unit-stride axis, for PERMUTE_TRANSPOSE
+    size_t nouter;              // number of outer axes
+    axis_t outer[PERMUTE_MAX_DIMS];
+    size_t count;               // product of the outer extents
+    size_t chunk;               // outer indices per pool task
+} plan_t;
+
+/**
+ * @brief Applies the inner operation at one outer offset.
+ */
+static void run_inner(const plan_t *plan, const double *a, double *b) {
+    switch (plan->inner) {
+    case PERMUTE_COPY:
+        memcpy(b, a, plan->row.ext * sizeof(double));
+        break;
+    case PERMUTE_TRANSPOSE:
+        transposeView(plan->row.ext, plan->col.ext, a, plan->row.sa, b,
+                      plan->col.sb);
+        break;
+    case PERMUTE_GENERIC:
+        for (size_t i = 0; i < plan->row.ext; i++) {
+            b[i * plan->row.sb] = a[i * plan->row.sa];
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Runs the inner operation for outer indices [first, last).
+ *
+ * The first index is decoded into per-axis coordinates once; the rest are
+ * reached by incrementing them like an odometer.
+ */
+static void run_range(const plan_t *plan, size_t first, size_t last) {
+    size_t coord[PERMUTE_MAX_DIMS];
+    size_t offa = 0;
+    size_t offb = 0;
+
+    size_t rest = first;
+    for (size_t d = plan->nouter; d-- > 0;) {
+        coord[d] = rest % plan->outer[d].ext;
+        rest /= plan->outer[d].ext;
+        offa += coord[d] * plan->outer[d].sa;
+        offb += coord[d] * plan->outer[d].sb;
+    }
+
+    for (size_t k = first; k < last; k++) {
+        run_inner(plan, plan->A + offa, plan->B + offb);
+
+        for (size_t d = plan->nouter; d-- > 0;) {
+            offa += plan->outer[d].sa;
+            offb += plan->outer[d].sb;
+            if (++coord[d] < plan->outer[d].ext) {
+                break;
+            }
+            offa -= coord[d] * plan->outer[d].sa;
+            offb -= coord[d] * plan->outer[d].sb;
+            coord[d] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Pool task: runs one chunk of outer indices.
+ */
+static void permute_task(void *arg, size_t task) {
+    const plan_t *plan = arg;
+    size_t first = task * plan->chunk;
+    size_t last = first + plan->chunk;
+    run_range(plan, first, last < plan->count ? last : plan->count);
+}
+
+/**
+ * @brief Drops unit axes and merges axes that are contiguous in A and B.
+ *
+ * @param[in,out] axes Axes in B's order
+ * @param[in]     n    Number of axes
+ * @return The number of axes left
+ */
+static size_t simplify(axis_t *axes, size_t n) {
+    size_t m = 0;
+    for (size_t d = 0; d < n; d++) {
+        if (axes[d].ext == 1) {
+            continue;
+        }
+        if (m > 0 && axes[m - 1].sa == axes[d].sa * axes[d].ext &&
+            axes[m - 1].sb == axes[d].sb * axes[d].ext) {
+            axes[m - 1].ext *= axes[d].ext;
+            axes[m - 1].sa = axes[d].sa;
+            axes[m - 1].sb = axes[d].sb;
+            continue;
+        }
+        axes[m++] = axes[d];
+    }
+    return m;
+}
+
+/**
+ * @brief Permutes the axes of a strided N-D array of doubles.
+ *
+ * Axis d of B is axis perm[d] of A, so B has extent shape[perm[d]] along
+ * axis d, and B[..., i_d, ...] = A[..., i_perm[d], ...]. A 2-D transpose of
+ * a sub-matrix view is ndim = 2, perm = {1, 0}, with its leading dimensions
+ * passed as strides.
+ *
+ * @param[in]  ndim    Number of axes, at most PERMUTE_MAX_DIMS
+ * @param[in]  shape   Extent of each axis of A
+ * @param[in]  perm    Axis of A that becomes each axis of B
+ * @param[in]  A       Source array
+ * @param[in]  strideA Stride of each axis of A in elements, or NULL for a
+ *                     contiguous row-major A
+ * @param[out] B       Destination array; must not overlap A
+ * @param[in]  strideB Stride of each axis of B in elements, or NULL for a
+ *                     contiguous row-major B
+ * @return False if ndim or perm is invalid, true otherwise
+ */
+bool transposePermute(size_t ndim, const size_t *shape, const size_t *perm,
+                      const double *A, const size_t *strideA, double *B,
+                      const size_t *strideB) {
+    if (ndim == 0 || ndim > PERMUTE_MAX_DIMS) {
+        fprintf(stderr, "Error: permutations of %zu axes are not supported\n",
+                ndim);
+        return false;
+    }
+
+    bool seen[PERMUTE_MAX_DIMS] = {false};
+    for (size_t d = 0; d < ndim; d++) {
+        if (perm[d] >= ndim || seen[perm[d]]) {
+            fprintf(stderr, "Error: axis order is not a permutation\n");
+            return false;
+        }
+        seen[perm[d]] = true;
+    }
+    for (size_t d = 0; d < ndim; d++) {
+        if (shape[d] == 0) {
+            return true;
+        }
+    }
+
+    size_t sa[PERMUTE_MAX_DIMS];
+    size_t sb[PERMUTE_MAX_DIMS];
+    size_t stride_a = 1;
+    size_t stride_b = 1;
+    for (size_t d = ndim; d-- > 0;) {
+        sa[d] = strideA != NULL ? strideA[d] : stride_a;
+        sb[d] = strideB != NULL ? strideB[d] : stride_b;
+        stride_a *= shape[d];
+        stride_b *= shape[perm[d]];
+    }
+
+    axis_t axes[PERMUTE_MAX_DIMS];
+    for (size_t d = 0; d < ndim; d++) {
+        axes[d].ext = shape[perm[d]];
+        axes[d].sa = sa[perm[d]];
+        axes[d].sb = sb[d];
+    }
+    size_t n = simplify(axes, ndim);
+    if (n == 0) {
+        B[0] = A[0];
+        return true;
+    }
+
+    plan_t plan = {.A = A, .B = B, .row = axes[n - 1], .nouter = 0};
+    size_t unit = n;
+    for (size_t d = 0; d + 1 < n; d++) {
+        if (axes[d].sa == 1) {
+            unit = d;
+        }
+    }
+
+    if (plan.row.sa == 1 && plan.row.sb == 1) {
+        plan.inner = PERMUTE_COPY;
+    } else if (plan.row.sb == 1 && unit < n && plan.row.sa >= axes[unit].ext &&
+               axes[unit].sb >= plan.row.ext) {
+        plan.inner = PERMUTE_TRANSPOSE;
+        plan.col = axes[unit];
+    } else {
+        plan.inner = PERMUTE_GENERIC;
+        unit = n;
+    }
+
+    plan.count = 1;
+    for (size_t d = 0; d + 1 < n; d++) {
+        if (d != unit) {
+            plan.outer[plan.nouter++] = axes[d];
+            plan.count *= axes[d].ext;
+        }
+    }
+
+    size_t inner = plan.row.ext;
+    if (plan.inner == PERMUTE_TRANSPOSE) {
+        inner *= plan.col.ext;
+    }
+    size_t threads = poolSize();
+    if (plan.count > 1 && plan.count * inner >= PERMUTE_PARALLEL_MIN &&
+        threads > 1) {
+        size_t tasks = 4 * threads < plan.count ? 4 * threads : plan.count;
+        plan.chunk = (plan.count + tasks - 1) / tasks;
+        poolRun((plan.count + plan.chunk - 1) / plan.chunk, permute_task,
+                &plan);
+    } else {
+        run_range(&plan, 0, plan.count);
+    }
+    return true;
+}
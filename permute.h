@@ -0,0 +1,20 @@
+/**
+ * @file permute.h
+ * @brief Prototypes for the strided N-D axis permutation engine
+ */
+
+#ifndef PERMUTE_TOOLS_H
+#define PERMUTE_TOOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Largest number of dimensions transposePermute() accepts */
+#define PERMUTE_MAX_DIMS 8
+
+/** @brief Permutes the axes of a strided N-D array of doubles */
+bool transposePermute(size_t ndim, const size_t *shape, const size_t *perm,
+                      const double *A, const size_t *strideA, double *B,
+                      const size_t *strideB);
+
+#endif /* PERMUTE_TOOLS_H */
@@ -0,0 +1,163 @@
+/**
+ * @file pool.c
+ * @brief Persistent worker thread pool with dynamic task scheduling
+ *
+ * The workers are started on the first call to poolRun() and then sleep on a
+ * condition variable between jobs. A job is a count of independent tasks;
+ * the caller and every worker repeatedly claim the next unclaimed index with
+ * an atomic counter, so uneven tasks balance themselves.
+ *
+ * The pool uses one thread per online CPU. The TRANS_THREADS environment
+ * variable overrides that count; TRANS_THREADS=1 runs everything on the
+ * calling thread.
+ *
+ * @author Yifan Gu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/** @brief Upper bound on the number of threads the pool will start */
+#define POOL_MAX_THREADS 256
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER; // one job at once
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;     // guards below
+static pthread_cond_t work_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cv = PTHREAD_COND_INITIALIZER;
+
+static size_t num_workers = 0;        // threads started besides the caller
+static unsigned long generation = 0;  // bumped once per job
+static size_t busy = 0;               // workers still draining the job
+static pool_task_t job_task = NULL;   // current job
+static void *job_arg = NULL;
+static size_t job_tasks = 0;
+static atomic_size_t job_next;        // next unclaimed task index
+
+static _Thread_local bool in_pool = false; // true while running a task
+
+/**
+ * @brief Claims and runs tasks of the current job until none are left.
+ */
+static void drain(void) {
+    size_t task;
+    while ((task = atomic_fetch_add(&job_next, 1)) < job_tasks) {
+        job_task(job_arg, task);
+    }
+}
+
+/**
+ * @brief Worker loop: wait for a new generation, drain it, report back.
+ */
+static void *worker(void *unused) {
+    unsigned long seen = 0;
+    in_pool = true;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (generation == seen) {
+            pthread_cond_wait(&work_cv, &lock);
+        }
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+
+        drain();
+
+        pthread_mutex_lock(&lock);
+        if (--busy == 0) {
+            pthread_cond_signal(&done_cv);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the worker threads. Runs exactly once.
+ */
+static void start(void) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("TRANS_THREADS");
+    if (env != NULL) {
+        threads = atol(env);
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > POOL_MAX_THREADS) {
+        threads = POOL_MAX_THREADS;
+    }
+
+    for (long i = 1; i < threads; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, worker, NULL) != 0) {
+            fprintf(stderr, "Warning: started only %zu pool workers\n",
+                    num_workers);
+            break;
+        }
+        pthread_detach(tid);
+        num_workers++;
+    }
+}
+
+/**
+ * @brief Number of threads, including the caller, that poolRun() uses.
+ *
+ * @return The pool size, at least 1
+ */
+size_t poolSize(void) {
+    pthread_once(&pool_once, start);
+    return num_workers + 1;
+}
+
+/**
+ * @brief Runs task(arg, t) for every t in [0, ntasks) and waits for them.
+ *
+ * The calling thread takes part in the job. Calls made from inside a task
+ * run serially on that thread instead of deadlocking on the pool.
+ *
+ * @param[in] ntasks Number of tasks in the job
+ * @param[in] task   Function run once per task index
+ * @param[in] arg    Passed through to every call of task
+ */
+void poolRun(size_t ntasks, pool_task_t task, void *arg) {
+    pthread_once(&pool_once, start);
+
+    if (num_workers == 0 || ntasks <= 1 || in_pool) {
+        for (size_t t = 0; t < ntasks; t++) {
+            task(arg, t);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&run_lock);
+
+    pthread_mutex_lock(&lock);
+    job_task = task;
+    job_arg = arg;
+    job_tasks = ntasks;
+    atomic_store(&job_next, 0);
+    busy = num_workers;
+    generation++;
+    pthread_cond_broadcast(&work_cv);
+    pthread_mutex_unlock(&lock);
+
+    in_pool = true;
+    drain();
+    in_pool = false;
+
+    pthread_mutex_lock(&lock);
+    while (busy > 0) {
+        pthread_cond_wait(&done_cv, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    pthread_mutex_unlock(&run_lock);
+}
@@ -0,0 +1,25 @@
+/**
+ * @file pool.h
+ * @brief Prototypes for the persistent worker thread pool
+ */
+
+#ifndef POOL_TOOLS_H
+#define POOL_TOOLS_H
+
+#include <stddef.h>
+
+/**
+ * @brief Function run by the pool once for each task index
+ *
+ * @param[in] arg  The argument passed to poolRun()
+ * @param[in] task Index of the task, in [0, ntasks)
+ */
+typedef void (*pool_task_t)(void *arg, size_t task);
+
+/** @brief Number of threads, including the caller, that poolRun() uses */
+size_t poolSize(void);
+
+/** @brief Runs every task on the pool and waits for all of them to finish */
+void poolRun(size_t ntasks, pool_task_t task, void *arg);
+
+#endif /* POOL_TOOLS_H */
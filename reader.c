@@ -0,0 +1,404 @@
+/**
+ * @file reader.c
+ * @brief Streams memory traces of several capture tools as one record type
+ *
+ * Every format is decoded straight into batches of reader_record_t, the
+ * records the simulator consumes, without converting to text first:
+ *
+ * - lackey: the "Op Addr,Size" text csim has always read, with the leading
+ *   spaces and banner lines of valgrind lackey output.
+ * - drmemtrace: the post-processed offline traces of DynamoRIO's
+ *   drmemtrace, a stream of packed 12-byte trace_entry_t records (a 16-bit
+ *   type, a 16-bit size and a 64-bit address). Reads and writes become
+ *   loads and stores, instruction entries (the branch kinds, sysenter and
+ *   the newer taken/untaken jumps included) become fetches, and a bundle
+ *   becomes one fetch per bundled instruction, laid out after the previous
+ *   instruction by the lengths it carries. Prefetches, no-fetch
+ *   instructions, markers and headers are skipped.
+ * - champsim: ChampSim's 64-byte input_instr records. Each instruction
+ *   becomes a fetch of its ip, then a load per source memory operand and a
+ *   store per destination memory operand that is not zero.
+ *
+ * Both binary formats are read little-endian, a block of records per
+ * fread(). Compressed traces are read by passing "-" and piping them
+ * through xz or gzip.
+ *
+ * Traces can also be written as lackey text or as drmemtrace entries, so
+ * that a stream csim produces can be read back by any later run. ChampSim
+ * records group accesses by instruction, so they are read only.
+ *
+ * @author Yifan Gu
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader.h"
+
+/** @brief Bytes of one drmemtrace trace_entry_t */
+#define DRMEMTRACE_ENTRY 12
+
+/** @brief drmemtrace entry types: read, write, first and last fetch */
+#define DRMEMTRACE_READ 0
+#define DRMEMTRACE_WRITE 1
+#define DRMEMTRACE_INSTR 10
+#define DRMEMTRACE_INSTR_LAST 16
+
+/** @brief drmemtrace fetch types outside that range, and the bundle */
+#define DRMEMTRACE_INSTR_BUNDLE 17
+#define DRMEMTRACE_INSTR_SYSENTER 31
+#define DRMEMTRACE_INSTR_TAKEN_JUMP 48
+#define DRMEMTRACE_INSTR_UNTAKEN_JUMP 49
+
+/** @brief Most instructions one bundle entry carries */
+#define DRMEMTRACE_BUNDLE_MAX 8
+
+/** @brief Bytes of one ChampSim input_instr */
+#define CHAMPSIM_INSTR 64
+
+/** @brief Offsets of the ip and the memory operands in an input_instr */
+#define CHAMPSIM_IP 0
+#define CHAMPSIM_DESTINATIONS 16
+#define CHAMPSIM_SOURCES 32
+
+/** @brief Memory operands of an input_instr: 2 destinations, 4 sources */
+#define CHAMPSIM_NUM_DESTINATIONS 2
+#define CHAMPSIM_NUM_SOURCES 4
+
+/** @brief Most records one input_instr decodes into */
+#define CHAMPSIM_RECORDS                                                       \
+    (1 + CHAMPSIM_NUM_DESTINATIONS + CHAMPSIM_NUM_SOURCES)
+
+/** @brief Longest lackey line read */
+#define LACKEY_LINE 64
+
+static const char *format_names[READER_NUM_FORMATS] = {"lackey", "drmemtrace",
+                                                       "champsim"};
+
+/** @brief Value of each hexadecimal digit character, or -1 */
+static signed char hex_value[256];
+static bool hex_ready = false;
+
+/**
+ * @brief Fills hex_value on first use.
+ */
+static void init_hex(void) {
+    if (hex_ready) {
+        return;
+    }
+    hex_ready = true;
+    memset(hex_value, -1, sizeof(hex_value));
+    for (int i = 0; i < 10; i++) {
+        hex_value['0' + i] = (signed char)i;
+    }
+    for (int i = 0; i < 6; i++) {
+        hex_value['a' + i] = (signed char)(10 + i);
+        hex_value['A' + i] = (signed char)(10 + i);
+    }
+}
+
+/**
+ * @brief Writes a little-endian integer of bytes bytes.
+ */
+static void store_le(unsigned char *p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Reads a little-endian integer of bytes bytes.
+ */
+static uint64_t load_le(const unsigned char *p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = value << 8 | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Splits one lackey line into a record.
+ *
+ * Hand-rolled instead of strtok() and strtol(): this runs once per record,
+ * and the digits are decoded through a table without per-character tests
+ * of their kind.
+ *
+ * @return False if the line is not a record, such as a valgrind banner
+ */
+static bool parse_lackey(const char *line, reader_record_t *record) {
+    const unsigned char *p = (const unsigned char *)line;
+    while (*p == ' ') {
+        p++;
+    }
+    record->op = (char)*p++;
+    while (*p == ' ') {
+        p++;
+    }
+
+    unsigned long value = 0;
+    const unsigned char *digits = p;
+    for (int digit; (digit = hex_value[*p]) >= 0; p++) {
+        value = value << 4 | (unsigned long)digit;
+    }
+    if (p == digits || *p != ',') {
+        return false;
+    }
+    record->addr = value;
+
+    int bytes = 0;
+    for (p++; (unsigned)(*p - '0') < 10; p++) {
+        bytes = bytes * 10 + (*p - '0');
+    }
+    record->size = bytes;
+    return true;
+}
+
+/**
+ * @brief Decodes up to max lackey records.
+ */
+static size_t next_lackey(reader_t *reader, reader_record_t *records,
+                          size_t max) {
+    char line[LACKEY_LINE];
+    size_t n = 0;
+    while (n < max && fgets(line, sizeof(line), reader->fp) != NULL) {
+        n += parse_lackey(line, &records[n]);
+    }
+    return n;
+}
+
+/**
+ * @brief Decodes a block of drmemtrace entries into at most max records.
+ */
+static size_t next_drmemtrace(reader_t *reader, reader_record_t *records,
+                              size_t max) {
+    size_t n = 0;
+    while (n == 0) {
+        size_t entries = fread(reader->block, DRMEMTRACE_ENTRY,
+                               max / DRMEMTRACE_BUNDLE_MAX, reader->fp);
+        if (entries == 0) {
+            return 0;
+        }
+        for (size_t e = 0; e < entries; e++) {
+            const unsigned char *entry = reader->block + e * DRMEMTRACE_ENTRY;
+            unsigned type = (unsigned)load_le(entry, 2);
+            unsigned size = (unsigned)load_le(entry + 2, 2);
+            unsigned long addr = (unsigned long)load_le(entry + 4, 8);
+            char op;
+            if (type == DRMEMTRACE_INSTR_BUNDLE) {
+                // size counts the instructions, the address bytes hold
+                // their lengths
+                for (unsigned k = 0; k < size && k < DRMEMTRACE_BUNDLE_MAX;
+                     k++) {
+                    records[n++] = (reader_record_t){reader->pc, entry[4 + k],
+                                                     'I'};
+                    reader->pc += entry[4 + k];
+                }
+                continue;
+            }
+            if (type == DRMEMTRACE_READ) {
+                op = 'L';
+            } else if (type == DRMEMTRACE_WRITE) {
+                op = 'S';
+            } else if ((type >= DRMEMTRACE_INSTR &&
+                        type <= DRMEMTRACE_INSTR_LAST) ||
+                       type == DRMEMTRACE_INSTR_SYSENTER ||
+                       type == DRMEMTRACE_INSTR_TAKEN_JUMP ||
+                       type == DRMEMTRACE_INSTR_UNTAKEN_JUMP) {
+                op = 'I';
+                reader->pc = addr + size;
+            } else {
+                continue;
+            }
+            records[n++] = (reader_record_t){addr, (int)size, op};
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Decodes a block of ChampSim instructions into at most max records.
+ */
+static size_t next_champsim(reader_t *reader, reader_record_t *records,
+                            size_t max) {
+    size_t instrs = fread(reader->block, CHAMPSIM_INSTR,
+                          max / CHAMPSIM_RECORDS, reader->fp);
+    size_t n = 0;
+    for (size_t i = 0; i < instrs; i++) {
+        const unsigned char *instr = reader->block + i * CHAMPSIM_INSTR;
+        records[n++] = (reader_record_t){
+            (unsigned long)load_le(instr + CHAMPSIM_IP, 8), 0, 'I'};
+        for (int m = 0; m < CHAMPSIM_NUM_SOURCES; m++) {
+            uint64_t addr = load_le(instr + CHAMPSIM_SOURCES + 8 * m, 8);
+            if (addr != 0) {
+                records[n++] = (reader_record_t){(unsigned long)addr, 0, 'L'};
+            }
+        }
+        for (int m = 0; m < CHAMPSIM_NUM_DESTINATIONS; m++) {
+            uint64_t addr = load_le(instr + CHAMPSIM_DESTINATIONS + 8 * m, 8);
+            if (addr != 0) {
+                records[n++] = (reader_record_t){(unsigned long)addr, 0, 'S'};
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Opens a trace.
+ *
+ * @param[out] reader The reader to initialize
+ * @param[in]  path   File name of the trace, or "-" for stdin
+ * @param[in]  format Format of the trace
+ *
+ * @return False if the file cannot be opened or memory ran out
+ */
+bool readerOpen(reader_t *reader, const char *path, reader_format_t format) {
+    memset(reader, 0, sizeof(*reader));
+    init_hex();
+    reader->format = format;
+    if (format != READER_LACKEY) {
+        reader->block = malloc((size_t)READER_BATCH * CHAMPSIM_INSTR);
+        if (reader->block == NULL) {
+            return false;
+        }
+    }
+
+    reader->fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (reader->fp == NULL) {
+        free(reader->block);
+        reader->block = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Decodes the next records of a trace.
+ *
+ * @param[in,out] reader  The trace
+ * @param[out]    records Receives the records, in trace order
+ * @param[in]     max     Capacity of records, at most READER_BATCH and at
+ *                        least CHAMPSIM_RECORDS and DRMEMTRACE_BUNDLE_MAX
+ *
+ * @return Number of records decoded, 0 at the end of the trace
+ */
+size_t readerNext(reader_t *reader, reader_record_t *records, size_t max) {
+    switch (reader->format) {
+    case READER_DRMEMTRACE:
+        return next_drmemtrace(reader, records, max);
+    case READER_CHAMPSIM:
+        return next_champsim(reader, records, max);
+    default:
+        return next_lackey(reader, records, max);
+    }
+}
+
+/**
+ * @brief Creates a trace to write.
+ *
+ * @param[out] writer The writer to initialize
+ * @param[in]  path   File name of the trace, or "-" for stdout
+ * @param[in]  format READER_LACKEY or READER_DRMEMTRACE
+ *
+ * @return False if the format cannot be written, the file cannot be
+ *         created or memory ran out
+ */
+bool readerCreate(reader_t *writer, const char *path, reader_format_t format) {
+    memset(writer, 0, sizeof(*writer));
+    writer->format = format;
+    writer->writing = true;
+    if (format == READER_CHAMPSIM) {
+        return false;
+    }
+    if (format == READER_DRMEMTRACE) {
+        writer->block = malloc((size_t)READER_BATCH * DRMEMTRACE_ENTRY);
+        if (writer->block == NULL) {
+            return false;
+        }
+    }
+
+    writer->fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (writer->fp == NULL) {
+        free(writer->block);
+        writer->block = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes out the buffered drmemtrace entries.
+ */
+static void flush_block(reader_t *writer) {
+    fwrite(writer->block, DRMEMTRACE_ENTRY, writer->used, writer->fp);
+    writer->used = 0;
+}
+
+/**
+ * @brief Appends one record to a trace from readerCreate().
+ *
+ * @param[in,out] writer The trace
+ * @param[in]     record The record; drmemtrace writes 'M' as a store
+ */
+void readerPut(reader_t *writer, const reader_record_t *record) {
+    if (writer->format == READER_LACKEY) {
+        fprintf(writer->fp, "%s%c %lx,%d\n", record->op == 'I' ? "" : " ",
+                record->op, record->addr, record->size);
+        return;
+    }
+
+    unsigned type = record->op == 'I'   ? DRMEMTRACE_INSTR
+                    : record->op == 'L' ? DRMEMTRACE_READ
+                                        : DRMEMTRACE_WRITE;
+    unsigned char *entry = writer->block + writer->used * DRMEMTRACE_ENTRY;
+    store_le(entry, type, 2);
+    store_le(entry + 2, (uint64_t)record->size, 2);
+    store_le(entry + 4, record->addr, 8);
+    if (++writer->used == READER_BATCH) {
+        flush_block(writer);
+    }
+}
+
+/**
+ * @brief Closes a trace from readerOpen() or readerCreate().
+ */
+void readerClose(reader_t *reader) {
+    if (reader->writing && reader->block != NULL) {
+        flush_block(reader);
+    }
+    if (reader->fp != NULL && reader->fp != stdin && reader->fp != stdout) {
+        fclose(reader->fp);
+    } else if (reader->fp == stdout) {
+        fflush(stdout);
+    }
+    free(reader->block);
+    reader->fp = NULL;
+    reader->block = NULL;
+}
+
+/**
+ * @brief Short name of format.
+ */
+const char *readerFormatName(reader_format_t format) {
+    return format_names[format];
+}
+
+/**
+ * @brief Parses a name from readerFormatName().
+ *
+ * @param[in]  name   Name to parse
+ * @param[out] format Matching format
+ *
+ * @return False if name is unknown, true otherwise
+ */
+bool readerFormatParse(const char *name, reader_format_t *format) {
+    for (int f = 0; f < READER_NUM_FORMATS; f++) {
+        if (strcmp(name, format_names[f]) == 0) {
+            *format = (reader_format_t)f;
+            return true;
+        }
+    }
+    return false;
+}
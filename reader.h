@@ -0,0 +1,68 @@
+/**
+ * @file reader.h
+ * @brief Prototypes for the memory trace file readers and writers
+ */
+
+#ifndef READER_TOOLS_H
+#define READER_TOOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** @brief Records decoded per readerNext() call by the simulator */
+#define READER_BATCH 4096
+
+/**
+ * @brief Enum of the trace file formats that can be read
+ */
+typedef enum {
+    READER_LACKEY,     // "Op Addr,Size" text, as written by valgrind lackey
+    READER_DRMEMTRACE, // DynamoRIO drmemtrace trace_entry_t records
+    READER_CHAMPSIM,   // ChampSim input_instr records
+    READER_NUM_FORMATS
+} reader_format_t;
+
+/**
+ * @brief Struct representing one memory access of a trace
+ */
+typedef struct {
+    unsigned long addr; // address accessed
+    int size;           // bytes accessed, 0 if the format does not say
+    char op;            // 'L', 'S', 'M' or 'I'
+} reader_record_t;
+
+/**
+ * @brief Struct representing a trace file open for reading or writing
+ */
+typedef struct {
+    FILE *fp;               // the trace, or stdin
+    reader_format_t format; // how its records are decoded
+    unsigned char *block;   // raw records of one binary block
+    size_t used;            // records buffered in block, when writing
+    bool writing;           // opened by readerCreate()
+    unsigned long pc;       // address after the last drmemtrace fetch
+} reader_t;
+
+/** @brief Opens path, or stdin for "-", as a trace of the given format */
+bool readerOpen(reader_t *reader, const char *path, reader_format_t format);
+
+/** @brief Decodes up to max records; returns 0 at the end of the trace */
+size_t readerNext(reader_t *reader, reader_record_t *records, size_t max);
+
+/** @brief Creates path, or stdout for "-", as a lackey or drmemtrace trace */
+bool readerCreate(reader_t *writer, const char *path, reader_format_t format);
+
+/** @brief Appends one record to a trace from readerCreate() */
+void readerPut(reader_t *writer, const reader_record_t *record);
+
+/** @brief Closes a trace from readerOpen() or readerCreate() */
+void readerClose(reader_t *reader);
+
+/** @brief Short name of format */
+const char *readerFormatName(reader_format_t format);
+
+/** @brief Parses a name from readerFormatName(); false if unknown */
+bool readerFormatParse(const char *name, reader_format_t *format);
+
+#endif /* READER_TOOLS_H */
@@ -0,0 +1,174 @@
+/**
+ * @file setalias.c
+ * @author Yifan Gu
+ * @brief Predicts set conflicts between A and B for given shapes
+ *
+ * For each shape, maps every tile of A and of B onto the cache sets with
+ * the analyzer in alias.c, without running or simulating the transpose,
+ * and prints the row distances at which A and B alias, the estimated
+ * conflict lines, the densest sets and the row padding and B offset that
+ * minimise the conflicts.
+ *
+ * Command-line usage:
+ *   ./setalias [-s <s> -E <E> -b <b>] [-t <tile>] [-a <addr>] [-o <bytes>]
+ *              <M>x<N> ...
+ *   ./setalias -h
+ *
+ * -h    Print this help message and exit
+ * -s    <s> Number of set index bits (default TEST_LOG_SET)
+ * -E    <E> Number of lines per set (default TEST_ASSOC)
+ * -b    <b> Number of block bits (default TEST_LOG_BLOCK)
+ * -t    <tile> Tile edge of the transpose (default one block of doubles)
+ * -a    <addr> Address of A, in hex (default 0)
+ * -o    <bytes> Gap between the end of A and the start of B (default 0)
+ *
+ * As in the reference driver, B starts right after A unless -o moves it.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "alias.h"
+#include "cache.h"
+
+/** @brief Number of densest sets listed per shape */
+#define DENSEST_SETS 4
+
+/**
+ * @brief Print help message when -h option is called or param error.
+ */
+static void printHelpMessage(void) {
+    printf("Usage: ./setalias [-s <s> -E <E> -b <b>] [-t <tile>] [-a <addr>] "
+           "[-o <bytes>]\n");
+    printf("                  <M>x<N> ...\n");
+    printf("       ./setalias -h\n\n");
+    printf("  -h            Print this help message and exit\n");
+    printf("  -s <s>        Number of set index bits (there are 2**s sets)\n");
+    printf("  -E <E>        Number of lines per set (associativity)\n");
+    printf("  -b <b>        Number of block bits (there are 2**b blocks)\n");
+    printf("  -t <tile>     Tile edge of the transpose\n");
+    printf("  -a <addr>     Address of A, in hex\n");
+    printf("  -o <bytes>    Gap between the end of A and the start of B\n");
+}
+
+/**
+ * @brief Returns the current time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    int s = TEST_LOG_SET;
+    int E = TEST_ASSOC;
+    int b = TEST_LOG_BLOCK;
+    size_t tile = 0;
+    unsigned long base = 0;
+    size_t gap = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hs:E:b:t:a:o:")) != -1) {
+        switch (opt) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            tile = (size_t)atol(optarg);
+            break;
+        case 'a':
+            base = strtoul(optarg, NULL, 16);
+            break;
+        case 'o':
+            gap = (size_t)atol(optarg);
+            break;
+        case 'h':
+            printHelpMessage();
+            return 0;
+        default:
+            printf("Invalid input.\n");
+            printHelpMessage();
+            return 1;
+        }
+    }
+    if (s < 0 || s > 20 || E <= 0 || b < 3 || b > 20 || optind == argc) {
+        printf("Invalid input.\n");
+        printHelpMessage();
+        return 1;
+    }
+    if (tile == 0) {
+        tile = ((size_t)1 << b) / sizeof(double);
+    }
+
+    size_t sets = (size_t)1 << s;
+    double *density = malloc(sets * sizeof(double));
+    if (density == NULL) {
+        printf("Invalid density memory\n");
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        size_t M, N;
+        if (sscanf(argv[i], "%zux%zu", &M, &N) != 2 || M == 0 || N == 0 ||
+            M > MAXN || N > MAXN) {
+            printf("Invalid shape: %s\n", argv[i]);
+            return 1;
+        }
+
+        double start = now();
+        alias_layout_t layout = {M, N, M, N, (uintptr_t)base,
+                                 (uintptr_t)base + M * N * sizeof(double) +
+                                     gap};
+        alias_report_t report;
+        aliasAnalyze(&layout, tile, s, E, b, &report, density);
+        size_t pad, offset;
+        double best;
+        aliasBestLayout(&layout, tile, s, E, b, &pad, &offset, &best);
+        double elapsed = now() - start;
+        alias_layout_t padded;
+        aliasPadLayout(&layout, pad, offset, &padded);
+        if (aliasOverlap(&padded)) {
+            printf("Overlapping layout recommended for %s\n", argv[i]);
+            return 1;
+        }
+
+        printf("%zux%zu: s=%d E=%d b=%d, tile %zu\n", M, N, s, E, b, tile);
+        printf("  rows alias every %zu of A, %zu of B (0: never)\n",
+               report.alias_a, report.alias_b);
+        printf("  conflicts: %.0f lines over associativity; %.2f lines per "
+               "used set, worst set %lu with %u\n",
+               report.conflicts, report.mean_lines, report.worst_set,
+               report.worst_lines);
+        printf("  densest sets:");
+        for (int d = 0; d < DENSEST_SETS && d < (int)sets; d++) {
+            size_t top = 0;
+            for (size_t set = 1; set < sets; set++) {
+                if (density[set] > density[top]) {
+                    top = set;
+                }
+            }
+            printf(" %zu (%.2f lines/tile)", top, density[top]);
+            density[top] = -1;
+        }
+        printf("\n");
+        printf("  best: pad rows by %zu doubles, B %zu bytes after %s "
+               "(at %#lx): %.0f conflicts\n",
+               pad, offset, pad == 0 ? "its start" : "the padded A",
+               (unsigned long)padded.B, best);
+        printf("  (%.2f ms)\n", elapsed * 1e3);
+    }
+
+    free(density);
+    return 0;
+}
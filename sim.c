@@ -0,0 +1,127 @@
+/**
+ * @file sim.c
+ * @brief Cache simulation engine
+ *
+ * A set-associative cache with LRU replacement and a write-back,
+ * write-allocate policy. Every line records the clock value of its last use;
+ * the line with the oldest stamp in a full set is the one evicted.
+ *
+ * The engine has no I/O of its own: csim.c drives it from trace files, and
+ * the in-process tracer drives it from instrumented transpose functions.
+ *
+ * @author Yifan Gu
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+
+/**
+ * @brief Allocates an empty cache with the given geometry.
+ *
+ * @param[out] cache The cache to initialize
+ * @param[in]  s     Number of set index bits (there are 2**s sets)
+ * @param[in]  E     Number of lines per set
+ * @param[in]  b     Number of block bits (there are 2**b bytes per block)
+ * @return False if the geometry is invalid or memory ran out
+ */
+bool simInit(sim_cache_t *cache, int s, int E, int b) {
+    memset(cache, 0, sizeof(*cache));
+    if (s < 0 || E <= 0 || b < 0 || s + b > 64 || s >= 32) {
+        return false;
+    }
+
+    cache->s = s;
+    cache->E = E;
+    cache->b = b;
+    cache->lines = calloc((size_t)E << s, sizeof(sim_line_t));
+    return cache->lines != NULL;
+}
+
+/**
+ * @brief Frees the lines of a cache.
+ */
+void simFree(sim_cache_t *cache) {
+    free(cache->lines);
+    cache->lines = NULL;
+}
+
+/**
+ * @brief Simulates one load ('L'), store ('S') or modify ('M') of addr.
+ *
+ * A modify is a load followed by a store to the same address. It is looked
+ * up once: the load part hits or misses like a load, and the store part
+ * then always hits, which is counted as a second hit.
+ *
+ * @param[in,out] cache  The cache
+ * @param[in]     addr   Address accessed
+ * @param[in]     op     'L' for a load, 'S' for a store, 'M' for a modify
+ * @param[out]    victim If not NULL and a line is evicted, receives the
+ *                       address of the evicted block
+ * @return A combination of the SIM_* result bits
+ */
+int simAccess(sim_cache_t *cache, unsigned long addr, char op,
+              unsigned long *victim) {
+    unsigned long block_bytes = 1UL << cache->b;
+    unsigned long set = simSet(addr, cache->s, cache->b);
+    unsigned long tag =
+        cache->s + cache->b < 64 ? addr >> (cache->s + cache->b) : 0;
+    sim_line_t *lines = &cache->lines[set * (unsigned long)cache->E];
+    unsigned long now = ++cache->clock;
+    bool store = op != 'L';
+    cache->stats.hits += op == 'M';
+
+    // Hit: refresh the line and mark it dirty on a store
+    for (int i = 0; i < cache->E; i++) {
+        if (lines[i].valid && lines[i].tag == tag) {
+            lines[i].stamp = now;
+            if (store && !lines[i].dirty) {
+                lines[i].dirty = true;
+                cache->stats.dirty_bytes += block_bytes;
+            }
+            cache->stats.hits++;
+            return SIM_HIT;
+        }
+    }
+
+    // Miss: fill an invalid line, or evict the least recently used one
+    int result = SIM_MISS;
+    cache->stats.misses++;
+
+    int index = -1;
+    for (int i = 0; i < cache->E; i++) {
+        if (!lines[i].valid) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        index = 0;
+        for (int i = 1; i < cache->E; i++) {
+            if (lines[i].stamp < lines[index].stamp) {
+                index = i;
+            }
+        }
+
+        result |= SIM_EVICT;
+        cache->stats.evictions++;
+        if (victim != NULL) {
+            *victim = (lines[index].tag << cache->s | set) << cache->b;
+        }
+        if (lines[index].dirty) {
+            result |= SIM_DIRTY_EVICT;
+            cache->stats.dirty_evictions += block_bytes;
+            cache->stats.dirty_bytes -= block_bytes;
+        }
+    }
+
+    lines[index].valid = true;
+    lines[index].tag = tag;
+    lines[index].stamp = now;
+    lines[index].dirty = store;
+    if (store) {
+        cache->stats.dirty_bytes += block_bytes;
+    }
+    return result;
+}
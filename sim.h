@@ -0,0 +1,65 @@
+/**
+ * @file sim.h
+ * @brief Prototypes for the cache simulation engine
+ */
+
+#ifndef SIM_TOOLS_H
+#define SIM_TOOLS_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "cache.h"
+
+/** @brief simAccess() result bit: the block was in the cache */
+#define SIM_HIT 0x1
+
+/** @brief simAccess() result bit: the block was not in the cache */
+#define SIM_MISS 0x2
+
+/** @brief simAccess() result bit: a valid line was evicted */
+#define SIM_EVICT 0x4
+
+/** @brief simAccess() result bit: the evicted line was dirty */
+#define SIM_DIRTY_EVICT 0x8
+
+/**
+ * @brief Struct representing one cache line
+ */
+typedef struct {
+    bool valid;          // true if the line is being used
+    bool dirty;          // true if the block is modified but not written back
+    unsigned long tag;   // used to match the line
+    unsigned long stamp; // time of last use, for LRU replacement
+} sim_line_t;
+
+/**
+ * @brief Struct representing a simulated cache and its statistics
+ */
+typedef struct {
+    int s;               // number of set index bits
+    int E;               // number of lines per set
+    int b;               // number of block offset bits
+    sim_line_t *lines;   // 2**s sets of E lines each
+    unsigned long clock; // advanced once per access
+    csim_stats_t stats;  // running statistics
+} sim_cache_t;
+
+/**
+ * @brief Set that addr maps to in a cache of 2**s sets of 2**b-byte blocks.
+ */
+static inline unsigned long simSet(unsigned long addr, int s, int b) {
+    return (addr >> b) & ((1UL << s) - 1);
+}
+
+/** @brief Allocates an empty cache with the given geometry */
+bool simInit(sim_cache_t *cache, int s, int E, int b);
+
+/** @brief Frees the lines of a cache */
+void simFree(sim_cache_t *cache);
+
+/** @brief Simulates one load ('L'), store ('S') or modify ('M') of addr */
+int simAccess(sim_cache_t *cache, unsigned long addr, char op,
+              unsigned long *victim);
+
+#endif /* SIM_TOOLS_H */
@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# @file test-csim-pipe.sh
+# @author Yifan Gu
+# @brief Checks the summary stored by a two-stage csim pipe
+#
+# Replays a generated lackey trace through "csim -o - ... | csim -t -" and
+# checks that .csim_results holds the numbers of the second stage only, as
+# printed on its stdout.
+#
+# Usage: ./test-csim-pipe.sh [path to csim]
+
+CSIM=$(cd "$(dirname "${1:-./csim}")" && pwd)/$(basename "${1:-./csim}")
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+# Loads and stores over 64 KiB, enough to miss in both stages
+awk 'BEGIN {
+    for (i = 0; i < 20000; i++) {
+        addr = (i * 7919 * 8) % 65536
+        printf(" %s %x,8\n", i % 3 == 0 ? "S" : "L", addr)
+    }
+}' > pipe.trace
+
+"$CSIM" -s 2 -E 1 -b 4 -o - -t pipe.trace 2> first.out |
+    "$CSIM" -s 6 -E 2 -b 4 -t - > second.out || exit 1
+
+expected=$(sed -n 's/^hits:\([0-9]*\) misses:\([0-9]*\) evictions:\([0-9]*\) dirty_bytes_in_cache:\([0-9]*\) dirty_bytes_evicted:\([0-9]*\)$/\1 \2 \3 \4 \5/p' second.out)
+stored=$(cat .csim_results)
+
+if [ -z "$expected" ] || [ "$stored" != "$expected" ]; then
+    echo "FAIL: .csim_results is \"$stored\", second stage printed \"$expected\""
+    exit 1
+fi
+if ! grep -q '^hits:' first.out; then
+    echo "FAIL: first stage printed no summary on stderr"
+    exit 1
+fi
+echo "PASS: .csim_results matches the second stage ($stored)"
+exit 0
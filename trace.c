@@ -0,0 +1,157 @@
+/**
+ * @file trace.c
+ * @brief In-process memory access recorder feeding the cache simulator
+ *
+ * Files compiled with TRACE_CFLAGS call a hook before every load and store.
+ * GCC's kernel address sanitizer mode emits these calls without pulling in
+ * the sanitizer runtime, so this file supplies the hooks itself: each
+ * access that falls inside a watched range is fed to the simulator, one
+ * simAccess() per cache block it touches.
+ *
+ * Only watched ranges are recorded. The instrumented build keeps some
+ * temporaries, such as vector registers, on the stack, and those accesses
+ * would not exist in an optimized build. Calls into uninstrumented code, such
+ * as memcpy(), are not seen.
+ *
+ * The recorder is not thread-safe. Callers must run the pool with a single
+ * thread (TRANS_THREADS=1) while recording.
+ *
+ * @author Yifan Gu
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+/**
+ * @brief Struct representing one watched address range
+ */
+typedef struct {
+    uintptr_t lo; // first byte
+    uintptr_t hi; // one past the last byte
+} range_t;
+
+static range_t ranges[TRACE_MAX_RANGES];
+static size_t num_ranges = 0;
+static sim_cache_t *target = NULL; // NULL when not recording
+static unsigned long recorded = 0;
+static trace_observer_t observer = NULL;
+static void *observer_arg = NULL;
+
+/**
+ * @brief Adds an address range whose accesses are recorded.
+ *
+ * @param[in] base  First byte of the range
+ * @param[in] bytes Length of the range
+ */
+void traceWatch(const void *base, size_t bytes) {
+    if (num_ranges < TRACE_MAX_RANGES) {
+        ranges[num_ranges].lo = (uintptr_t)base;
+        ranges[num_ranges].hi = (uintptr_t)base + bytes;
+        num_ranges++;
+    }
+}
+
+/**
+ * @brief Forgets every watched address range.
+ */
+void traceClear(void) {
+    num_ranges = 0;
+}
+
+/**
+ * @brief Starts feeding watched accesses into cache.
+ */
+void traceStart(sim_cache_t *cache) {
+    recorded = 0;
+    target = cache;
+}
+
+/**
+ * @brief Calls observer after every simulated access; NULL to stop.
+ */
+void traceObserve(trace_observer_t fn, void *arg) {
+    observer = fn;
+    observer_arg = arg;
+}
+
+/**
+ * @brief Stops recording.
+ */
+void traceStop(void) {
+    target = NULL;
+}
+
+/**
+ * @brief Number of watched accesses recorded since traceStart().
+ */
+unsigned long traceCount(void) {
+    return recorded;
+}
+
+/**
+ * @brief Feeds one access to the simulator if it is being watched.
+ */
+static inline void record(uintptr_t addr, size_t size, char op) {
+    if (target == NULL) {
+        return;
+    }
+
+    bool watched = false;
+    for (size_t r = 0; r < num_ranges; r++) {
+        if (addr >= ranges[r].lo && addr < ranges[r].hi) {
+            watched = true;
+            break;
+        }
+    }
+    if (!watched) {
+        return;
+    }
+
+    recorded++;
+    int b = target->b;
+    for (uintptr_t block = addr >> b; block <= (addr + size - 1) >> b;
+         block++) {
+        unsigned long victim = 0;
+        int result = simAccess(target, (unsigned long)(block << b), op,
+                               observer != NULL ? &victim : NULL);
+        if (observer != NULL) {
+            uintptr_t start = block << b;
+            observer(observer_arg, addr > start ? addr : start, op, result,
+                     victim);
+        }
+    }
+}
+
+/** @brief Defines the load and store hooks for one fixed access size */
+#define TRACE_HOOKS(size)                                                      \
+    void __asan_load##size##_noabort(uintptr_t addr);                          \
+    void __asan_store##size##_noabort(uintptr_t addr);                         \
+    void __asan_load##size##_noabort(uintptr_t addr) {                         \
+        record(addr, size, 'L');                                               \
+    }                                                                          \
+    void __asan_store##size##_noabort(uintptr_t addr) {                        \
+        record(addr, size, 'S');                                               \
+    }
+
+TRACE_HOOKS(1)
+TRACE_HOOKS(2)
+TRACE_HOOKS(4)
+TRACE_HOOKS(8)
+TRACE_HOOKS(16)
+
+void __asan_loadN_noabort(uintptr_t addr, size_t size);
+void __asan_storeN_noabort(uintptr_t addr, size_t size);
+void __asan_handle_no_return(void);
+
+void __asan_loadN_noabort(uintptr_t addr, size_t size) {
+    record(addr, size, 'L');
+}
+
+void __asan_storeN_noabort(uintptr_t addr, size_t size) {
+    record(addr, size, 'S');
+}
+
+void __asan_handle_no_return(void) {
+}
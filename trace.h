@@ -0,0 +1,53 @@
+/**
+ * @file trace.h
+ * @brief Prototypes for the in-process memory access recorder
+ */
+
+#ifndef TRACE_TOOLS_H
+#define TRACE_TOOLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+/** @brief Maximum number of address ranges the recorder watches at once */
+#define TRACE_MAX_RANGES 8
+
+/** @brief Compiler flags that instrument a file for the recorder */
+#define TRACE_CFLAGS                                                           \
+    "-fsanitize=kernel-address "                                               \
+    "--param asan-instrumentation-with-call-threshold=0 "                      \
+    "--param asan-stack=0 --param asan-globals=0"
+
+/**
+ * @brief Function told about every simulated block access
+ *
+ * @param[in] arg    The argument passed to traceObserve()
+ * @param[in] addr   Address accessed, within the block
+ * @param[in] op     'L' for a load, 'S' for a store
+ * @param[in] result SIM_* bits returned by simAccess()
+ * @param[in] victim Address of the evicted block, if result has SIM_EVICT
+ */
+typedef void (*trace_observer_t)(void *arg, uintptr_t addr, char op,
+                                 int result, unsigned long victim);
+
+/** @brief Adds an address range whose accesses are recorded */
+void traceWatch(const void *base, size_t bytes);
+
+/** @brief Forgets every watched address range */
+void traceClear(void);
+
+/** @brief Starts feeding watched accesses into cache */
+void traceStart(sim_cache_t *cache);
+
+/** @brief Calls observer after every simulated access; NULL to stop */
+void traceObserve(trace_observer_t observer, void *arg);
+
+/** @brief Stops recording */
+void traceStop(void);
+
+/** @brief Number of watched accesses recorded since traceStart() */
+unsigned long traceCount(void);
+
+#endif /* TRACE_TOOLS_H */
@@ -0,0 +1,734 @@
+/**
+ * @file tracesim.c
+ * @author Yifan Gu
+ * @brief Simulates the cache behaviour of every registered transpose
+ *
+ * Runs each function in func_list once on an M x N matrix and feeds its
+ * accesses to A, B and tmp straight into the cache simulator, without
+ * writing a trace file. trans.c must be compiled with TRACE_CFLAGS (see
+ * trace.h) for any accesses to be seen, and with NDEBUG so that the
+ * is_transpose() checks are not simulated too:
+ *
+ *   gcc -O2 -DNDEBUG -fsanitize=kernel-address \
+ *       --param asan-instrumentation-with-call-threshold=0 \
+ *       --param asan-stack=0 --param asan-globals=0 -c trans.c
+ *   gcc -O2 -pthread -o tracesim tracesim.c trace.c sim.c perf.c cache.c \
+ *       pool.c tune.c trans.o
+ *
+ * Command-line usage:
+ *   ./tracesim [-p] [-s <s> -E <E> -b <b>] [-M <M>] [-N <N>] [-f <func>]
+ *              [-H <prefix> [-F <format>]]
+ *   ./tracesim -B <budgets>
+ *   ./tracesim -W <budgets>
+ *   ./tracesim -h
+ *
+ * -p    Also run each function under hardware counters
+ * -h    Print this help message and exit
+ * -s    <s> Number of set index bits (default TEST_LOG_SET)
+ * -E    <E> Number of lines per set (default TEST_ASSOC)
+ * -b    <b> Number of block bits (default TEST_LOG_BLOCK)
+ * -M    <M> Width of A (default 32)
+ * -N    <N> Height of A (default 32)
+ * -f    <func> Only simulate the function at this index of func_list
+ * -H    <prefix> Write per-element miss and eviction heatmaps
+ * -F    <format> Heatmap format, pgm or csv (default pgm)
+ * -B    <budgets> Check every function against a miss budget file
+ * -W    <budgets> Write the current misses as a new budget file
+ *
+ * As in the reference driver, A and B are allocated back to back. The pool
+ * is limited to one thread, so parallel kernels are simulated serially.
+ * Non-temporal stores and memcpy() calls are not instrumented, so they do
+ * not reach the simulator.
+ *
+ * With -p each function is run a second time, from cold caches and with the
+ * recorder stopped, under the counters of perf.h, so the measured misses can
+ * be set against the simulated ones (pass the L1 geometry, e.g. -s 6 -E 8
+ * -b 6, to compare with L1D misses). The instrumented build still calls an
+ * empty hook per access, which inflates cycles and instructions but barely
+ * touches the data cache. Where the kernel refuses counters, as in most
+ * containers, only the simulated counts are printed.
+ *
+ * A budget file holds one line per cache geometry, shape and function:
+ *
+ *   <geometry> <M> <N> <misses> <description>
+ *
+ * where geometry is test (TEST_LOG_SET, TEST_ASSOC, TEST_LOG_BLOCK) or
+ * haswell (the Haswell L1). -B simulates every line and prints each one that
+ * misses more than its budget, as a -/+ pair of the budget and the actual
+ * misses, and exits with status 1 if there was any. Kernels that beat their
+ * budget are listed too, so that the file can be tightened with -W, which
+ * writes budgets for every registered function on a fixed list of shapes.
+ * The tuning table is ignored in both modes, A, B and tmp are 4KB aligned,
+ * and every kernel is pinned to the scalar micro-kernel (TRANS_ISA=scalar),
+ * so the counts depend neither on where the allocator puts the matrices nor
+ * on the vector units of the host. A run in which some line of A is never
+ * loaded or some line of B never stored, as far as the recorder can see,
+ * cannot be gated: its budget would not move if the hidden accesses
+ * regressed. -W leaves such functions out of the file, naming them, and -B
+ * fails a budget line whose run has unrecorded accesses.
+ *
+ * With -H, every simulated miss and eviction is charged to the element of A
+ * or B whose access caused it, and four maps are written per function:
+ * <prefix>-<func>-A-misses, -A-evictions, -B-misses and -B-evictions. Each
+ * has the shape of its matrix: N rows of M for A, M rows of N for B. PGM
+ * maps are scaled so that the busiest element is white; CSV maps hold the
+ * raw counts. Conflict misses along the diagonal, or at tile edges, show up
+ * as lines and grids.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "perf.h"
+#include "sim.h"
+#include "trace.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+/** @brief Longest line accepted from a budget file */
+#define BUDGET_MAX_LINE 512
+
+/**
+ * @brief Struct representing a cache geometry that budgets are kept for
+ */
+typedef struct {
+    const char *name;
+    int s;
+    int E;
+    int b;
+} geometry_t;
+
+static const geometry_t geometries[] = {
+    {"test", TEST_LOG_SET, TEST_ASSOC, TEST_LOG_BLOCK},
+    {"haswell", HASWELL_L1_SET, HASWELL_L1_ASSOC, HASWELL_L1_BLOCK},
+};
+
+/** @brief Shapes that -W writes budgets for */
+static const size_t budget_shapes[][2] = {
+    {32, 32}, {64, 64}, {61, 67}, {256, 256}, {1024, 1024},
+};
+
+/** @brief Index of the heatmap of misses */
+#define HEAT_MISSES 0
+
+/** @brief Index of the heatmap of evictions */
+#define HEAT_EVICTIONS 1
+
+/** @brief Number of heatmaps kept per matrix */
+#define HEAT_NUM_KINDS 2
+
+/** @brief Temporary array handed to every transpose function */
+static _Alignas(4096) double tmp[TMPCOUNT];
+
+/**
+ * @brief Print help message when -h option is called or param error.
+ */
+static void printHelpMessage(void) {
+    printf("Usage: ./tracesim [-p] [-s <s> -E <E> -b <b>] [-M <M>] "
+           "[-N <N>]\n");
+    printf("       ./tracesim -B <budgets>\n");
+    printf("       ./tracesim -W <budgets>\n");
+    printf("       ./tracesim -h\n\n");
+    printf("  -h            Print this help message and exit\n");
+    printf("  -p            Also run each function under hardware counters\n");
+    printf("  -s <s>        Number of set index bits (there are 2**s sets)\n");
+    printf("  -E <E>        Number of lines per set (associativity)\n");
+    printf("  -b <b>        Number of block bits (there are 2**b blocks)\n");
+    printf("  -M <M>        Width of A\n");
+    printf("  -N <N>        Height of A\n");
+    printf("  -f <func>     Only simulate the function at this index\n");
+    printf("  -H <prefix>   Write per-element miss and eviction heatmaps\n");
+    printf("  -F <format>   Heatmap format, pgm or csv (default pgm)\n");
+    printf("  -B <budgets>  Check every function against a miss budget file\n");
+    printf("  -W <budgets>  Write the current misses as a new budget file\n");
+}
+
+/**
+ * @brief Evicts bytes starting at p from every cache level, where possible.
+ */
+static void flush(const void *p, size_t bytes) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    const char *c = p;
+    for (size_t off = 0; off < bytes; off += 64) {
+        _mm_clflush(c + off);
+    }
+    _mm_mfence();
+#else
+    (void)p;
+    (void)bytes;
+#endif
+}
+
+/**
+ * @brief Prints the counts of the last perfStop(), n/a where unavailable.
+ */
+static void print_counters(const perf_counters_t *pc) {
+    printf("  hardware:");
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (perfAvailable(pc, (perf_event_t)e)) {
+            printf(" %s:%lu", perfEventName((perf_event_t)e), pc->count[e]);
+        } else {
+            printf(" %s:n/a", perfEventName((perf_event_t)e));
+        }
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Struct representing A, B and the reference transpose for one shape
+ */
+typedef struct {
+    size_t M;
+    size_t N;
+    double *A;   // followed directly by B, as in the reference driver
+    double *B;
+    double *ref; // correct transpose of A
+} matrices_t;
+
+/**
+ * @brief Allocates 4KB-aligned matrices for an M x N transpose.
+ *
+ * @return False if memory cannot be allocated, true otherwise
+ */
+static bool alloc_matrices(matrices_t *mat, size_t M, size_t N) {
+    size_t bytes = (2 * M * N * sizeof(double) + 4095) / 4096 * 4096;
+    mat->M = M;
+    mat->N = N;
+    mat->A = aligned_alloc(4096, bytes);
+    mat->B = mat->A + M * N;
+    mat->ref = malloc(M * N * sizeof(double));
+    if (mat->A == NULL || mat->ref == NULL) {
+        printf("Invalid matrix memory\n");
+        free(mat->A);
+        free(mat->ref);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Frees matrices from alloc_matrices().
+ */
+static void free_matrices(matrices_t *mat) {
+    free(mat->A);
+    free(mat->ref);
+}
+
+/**
+ * @brief Runs one function on fresh matrices with its accesses simulated.
+ *
+ * @param[in]  f       Index of the function in func_list
+ * @param[in]  mat     Matrices to run it on
+ * @param[in]  cache   Simulated cache, already initialized
+ * @param[out] correct Whether B came out as the transpose of A
+ *
+ * @return False if no accesses were recorded, true otherwise
+ */
+static bool simulate(int f, const matrices_t *mat, sim_cache_t *cache,
+                     bool *correct) {
+    size_t M = mat->M;
+    size_t N = mat->N;
+    double *A = mat->A;
+    double *B = mat->B;
+
+    initMatrix(M, N, (double(*)[M])A, (double(*)[N])B);
+    correctTrans(M, N, (double(*)[M])A, (double(*)[N])mat->ref);
+
+    traceClear();
+    traceWatch(A, M * N * sizeof(double));
+    traceWatch(B, M * N * sizeof(double));
+    traceWatch(tmp, sizeof(tmp));
+    traceStart(cache);
+    func_list[f].func_ptr(M, N, (double(*)[M])A, (double(*)[N])B, tmp);
+    traceStop();
+
+    *correct = memcmp(B, mat->ref, M * N * sizeof(double)) == 0;
+    if (traceCount() == 0) {
+        printf("Error: no accesses recorded; compile trans.c with %s\n",
+               TRACE_CFLAGS);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Struct representing the per-element heatmaps of one run
+ */
+typedef struct {
+    const matrices_t *mat;
+    unsigned long *counts[2][HEAT_NUM_KINDS]; // [0 for A, 1 for B][kind]
+} heatmap_t;
+
+/**
+ * @brief Charges one simulated access to the element of A or B it touched.
+ */
+static void heat_observe(void *arg, uintptr_t addr, char op, int result,
+                         unsigned long victim) {
+    heatmap_t *heat = arg;
+    size_t bytes = heat->mat->M * heat->mat->N * sizeof(double);
+    const double *bases[2] = {heat->mat->A, heat->mat->B};
+    (void)op;
+    (void)victim;
+
+    for (int m = 0; m < 2; m++) {
+        uintptr_t base = (uintptr_t)bases[m];
+        if (addr < base || addr >= base + bytes) {
+            continue;
+        }
+        size_t e = (addr - base) / sizeof(double);
+        if (result & SIM_MISS) {
+            heat->counts[m][HEAT_MISSES][e]++;
+        }
+        if (result & SIM_EVICT) {
+            heat->counts[m][HEAT_EVICTIONS][e]++;
+        }
+    }
+}
+
+/**
+ * @brief Writes one rows x cols heatmap as a binary PGM or a CSV grid.
+ *
+ * @return False if the file cannot be written, true otherwise
+ */
+static bool write_heatmap(const char *path, size_t rows, size_t cols,
+                          const unsigned long *counts, bool csv) {
+    FILE *fp = fopen(path, csv ? "w" : "wb");
+    if (fp == NULL) {
+        printf("File opening error.\n");
+        return false;
+    }
+
+    if (csv) {
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t c = 0; c < cols; c++) {
+                fprintf(fp, c == 0 ? "%lu" : ",%lu", counts[r * cols + c]);
+            }
+            fputc('\n', fp);
+        }
+    } else {
+        unsigned long max = 1;
+        for (size_t e = 0; e < rows * cols; e++) {
+            max = counts[e] > max ? counts[e] : max;
+        }
+        fprintf(fp, "P5\n%zu %zu\n255\n", cols, rows);
+        for (size_t e = 0; e < rows * cols; e++) {
+            fputc((int)(counts[e] * 255 / max), fp);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+/**
+ * @brief Writes the four heatmaps of function f.
+ *
+ * @return False if a file cannot be written, true otherwise
+ */
+static bool write_heatmaps(const heatmap_t *heat, const char *prefix, int f,
+                           bool csv) {
+    static const char *const kinds[HEAT_NUM_KINDS] = {"misses", "evictions"};
+    size_t M = heat->mat->M;
+    size_t N = heat->mat->N;
+    char path[BUDGET_MAX_LINE];
+
+    for (int m = 0; m < 2; m++) {
+        for (int k = 0; k < HEAT_NUM_KINDS; k++) {
+            snprintf(path, sizeof(path), "%s-%d-%c-%s.%s", prefix, f,
+                     m == 0 ? 'A' : 'B', kinds[k], csv ? "csv" : "pgm");
+            // A is N rows of M, B is M rows of N
+            if (!write_heatmap(path, m == 0 ? N : M, m == 0 ? M : N,
+                               heat->counts[m][k], csv)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Struct recording which lines of A were loaded and of B stored
+ */
+typedef struct {
+    const matrices_t *mat;
+    int b;                 // number of block bits
+    unsigned char *loaded; // one flag per line overlapping A
+    unsigned char *stored; // one flag per line overlapping B
+} coverage_t;
+
+/**
+ * @brief Number of cache lines overlapping bytes bytes at base.
+ */
+static size_t lines_over(const void *base, size_t bytes, int b) {
+    uintptr_t start = (uintptr_t)base;
+    return ((start + bytes - 1) >> b) - (start >> b) + 1;
+}
+
+/**
+ * @brief Flags the line of A a load touched, or of B a store touched.
+ */
+static void cover_observe(void *arg, uintptr_t addr, char op, int result,
+                          unsigned long victim) {
+    coverage_t *cov = arg;
+    size_t bytes = cov->mat->M * cov->mat->N * sizeof(double);
+    uintptr_t a = (uintptr_t)cov->mat->A;
+    uintptr_t b = (uintptr_t)cov->mat->B;
+    (void)result;
+    (void)victim;
+
+    if (op == 'L' && addr >= a && addr < a + bytes) {
+        cov->loaded[(addr >> cov->b) - (a >> cov->b)] = 1;
+    } else if (op == 'S' && addr >= b && addr < b + bytes) {
+        cov->stored[(addr >> cov->b) - (b >> cov->b)] = 1;
+    }
+}
+
+/**
+ * @brief Simulates one function on one shape and geometry.
+ *
+ * @param[out] misses  Number of simulated misses
+ * @param[out] correct Whether B came out as the transpose of A
+ * @param[out] traced  Whether every line of A was seen loaded and every
+ *                     line of B seen stored
+ *
+ * @return False if the run could not be simulated, true otherwise
+ */
+static bool misses_of(int f, size_t M, size_t N, const geometry_t *geo,
+                      unsigned long *misses, bool *correct, bool *traced) {
+    matrices_t mat;
+    sim_cache_t cache;
+    if (!alloc_matrices(&mat, M, N)) {
+        return false;
+    }
+    size_t bytes = M * N * sizeof(double);
+    size_t lines_a = lines_over(mat.A, bytes, geo->b);
+    size_t lines_b = lines_over(mat.B, bytes, geo->b);
+    coverage_t cov = {&mat, geo->b, calloc(lines_a, 1), calloc(lines_b, 1)};
+    if (cov.loaded == NULL || cov.stored == NULL ||
+        !simInit(&cache, geo->s, geo->E, geo->b)) {
+        printf("Invalid cache memory\n");
+        free(cov.loaded);
+        free(cov.stored);
+        free_matrices(&mat);
+        return false;
+    }
+
+    traceObserve(cover_observe, &cov);
+    bool ok = simulate(f, &mat, &cache, correct);
+    traceObserve(NULL, NULL);
+    *misses = cache.stats.misses;
+    *traced = memchr(cov.loaded, 0, lines_a) == NULL &&
+              memchr(cov.stored, 0, lines_b) == NULL;
+
+    simFree(&cache);
+    free(cov.loaded);
+    free(cov.stored);
+    free_matrices(&mat);
+    return ok;
+}
+
+/**
+ * @brief Writes budgets for every function on every shape and geometry.
+ *
+ * @return The exit status: 0 on success, 1 on failure
+ */
+static int write_budgets(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("File opening error.\n");
+        return 1;
+    }
+
+    fprintf(fp, "# Simulated miss budgets, checked by ./tracesim -B\n");
+    fprintf(fp, "# Scalar micro-kernel (TRANS_ISA=scalar); functions whose "
+                "loads of A or\n");
+    fprintf(fp, "# stores to B the recorder cannot see are left out\n");
+    fprintf(fp, "# geometry M N misses description\n");
+    for (size_t g = 0; g < sizeof(geometries) / sizeof(geometries[0]); g++) {
+        for (size_t sh = 0;
+             sh < sizeof(budget_shapes) / sizeof(budget_shapes[0]); sh++) {
+            size_t M = budget_shapes[sh][0];
+            size_t N = budget_shapes[sh][1];
+            for (int f = 0; f < func_counter; f++) {
+                unsigned long misses;
+                bool correct;
+                bool traced;
+                if (!misses_of(f, M, N, &geometries[g], &misses, &correct,
+                               &traced)) {
+                    fclose(fp);
+                    return 1;
+                }
+                if (!correct) {
+                    printf("func %d (%s) is incorrect at %zux%zu, no budget "
+                           "written\n",
+                           f, func_list[f].description, M, N);
+                    continue;
+                }
+                if (!traced) {
+                    printf("func %d (%s) has unrecorded accesses at %zux%zu, "
+                           "no budget written\n",
+                           f, func_list[f].description, M, N);
+                    continue;
+                }
+                fprintf(fp, "%s %zu %zu %lu %s\n", geometries[g].name, M, N,
+                        misses, func_list[f].description);
+            }
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Checks every line of a budget file.
+ *
+ * @return The exit status: 0 if every function is within its budget
+ */
+static int check_budgets(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("File opening error.\n");
+        return 1;
+    }
+
+    char line[BUDGET_MAX_LINE];
+    unsigned long checked = 0;
+    unsigned long failed = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char geo_name[16];
+        char desc[BUDGET_MAX_LINE];
+        size_t M, N;
+        unsigned long budget;
+        if (line[0] == '#' ||
+            sscanf(line, "%15s %zu %zu %lu %[^\n]", geo_name, &M, &N,
+                   &budget, desc) != 5) {
+            continue;
+        }
+
+        const geometry_t *geo = NULL;
+        for (size_t g = 0; g < sizeof(geometries) / sizeof(geometries[0]);
+             g++) {
+            if (strcmp(geo_name, geometries[g].name) == 0) {
+                geo = &geometries[g];
+            }
+        }
+        int f = 0;
+        while (f < func_counter && strcmp(desc, func_list[f].description) != 0)
+            f++;
+        if (geo == NULL || f == func_counter || M == 0 || N == 0 ||
+            M > MAXN || N > MAXN) {
+            printf("? %s", line);
+            failed++;
+            continue;
+        }
+
+        unsigned long misses;
+        bool correct;
+        bool traced;
+        if (!misses_of(f, M, N, geo, &misses, &correct, &traced)) {
+            fclose(fp);
+            return 1;
+        }
+        checked++;
+        if (!traced) {
+            printf("! %s %zu %zu %lu %s: loads of A or stores to B not "
+                   "recorded, budget cannot be checked\n",
+                   geo->name, M, N, budget, desc);
+            failed++;
+        } else if (!correct || misses > budget) {
+            printf("- %s %zu %zu %lu %s\n", geo->name, M, N, budget, desc);
+            printf("+ %s %zu %zu %lu %s (%+.1f%%)%s\n", geo->name, M, N,
+                   misses, desc,
+                   100.0 * ((double)misses - (double)budget) / (double)budget,
+                   correct ? "" : " INCORRECT");
+            failed++;
+        } else if (misses < budget) {
+            printf("  %s %zu %zu %lu %s: under budget by %lu\n", geo->name, M,
+                   N, misses, desc, budget - misses);
+        }
+    }
+    fclose(fp);
+
+    printf("%lu budgets checked, %lu failed\n", checked, failed);
+    return failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    int s = TEST_LOG_SET;
+    int E = TEST_ASSOC;
+    int b = TEST_LOG_BLOCK;
+    size_t M = 32;
+    size_t N = 32;
+    bool counters = false;
+    const char *check_path = NULL;
+    const char *write_path = NULL;
+    const char *heat_prefix = NULL;
+    bool heat_csv = false;
+    int only = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hps:E:b:M:N:B:W:f:H:F:")) != -1) {
+        switch (opt) {
+        case 'f':
+            only = atoi(optarg);
+            break;
+        case 'H':
+            heat_prefix = optarg;
+            break;
+        case 'F':
+            if (strcmp(optarg, "csv") != 0 && strcmp(optarg, "pgm") != 0) {
+                printf("Invalid input.\n");
+                printHelpMessage();
+                return 1;
+            }
+            heat_csv = strcmp(optarg, "csv") == 0;
+            break;
+        case 'B':
+            check_path = optarg;
+            break;
+        case 'W':
+            write_path = optarg;
+            break;
+        case 'p':
+            counters = true;
+            break;
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'M':
+            M = (size_t)atol(optarg);
+            break;
+        case 'N':
+            N = (size_t)atol(optarg);
+            break;
+        case 'h':
+            printHelpMessage();
+            return 0;
+        default:
+            printf("Invalid input.\n");
+            printHelpMessage();
+            return 1;
+        }
+    }
+    if (M == 0 || N == 0 || M > MAXN || N > MAXN) {
+        printf("Invalid input.\n");
+        printHelpMessage();
+        return 1;
+    }
+
+    setenv("TRANS_THREADS", "1", 1);
+    if (check_path != NULL || write_path != NULL) {
+        setenv("TRANS_TUNE_FILE", "/dev/null", 1);
+        setenv(TRANS_ISA_ENV, "scalar", 1);
+    }
+    registerFunctions();
+    if (check_path != NULL) {
+        return check_budgets(check_path);
+    }
+    if (write_path != NULL) {
+        return write_budgets(write_path);
+    }
+
+    matrices_t mat;
+    if (!alloc_matrices(&mat, M, N)) {
+        return 1;
+    }
+    double *A = mat.A;
+    double *B = mat.B;
+
+    heatmap_t heat = {&mat, {{NULL}}};
+    if (heat_prefix != NULL) {
+        for (int m = 0; m < 2; m++) {
+            for (int k = 0; k < HEAT_NUM_KINDS; k++) {
+                heat.counts[m][k] = malloc(M * N * sizeof(unsigned long));
+                if (heat.counts[m][k] == NULL) {
+                    printf("Invalid heatmap memory\n");
+                    return 1;
+                }
+            }
+        }
+    }
+
+    perf_counters_t pc;
+    if (counters && !perfOpen(&pc)) {
+        printf("Hardware counters unavailable (perf_event_open: %s); "
+               "printing simulated counts only\n",
+               strerror(errno));
+        counters = false;
+    }
+
+    printf("Cache: s=%d E=%d b=%d, matrix: %zux%zu\n", s, E, b, M, N);
+    for (int f = 0; f < func_counter; f++) {
+        if (only >= 0 && f != only) {
+            continue;
+        }
+        sim_cache_t cache;
+        if (!simInit(&cache, s, E, b)) {
+            printf("Invalid input.\n");
+            printHelpMessage();
+            return 1;
+        }
+
+        if (heat_prefix != NULL) {
+            for (int m = 0; m < 2; m++) {
+                for (int k = 0; k < HEAT_NUM_KINDS; k++) {
+                    memset(heat.counts[m][k], 0,
+                           M * N * sizeof(unsigned long));
+                }
+            }
+            traceObserve(heat_observe, &heat);
+        }
+        bool correct;
+        bool recorded = simulate(f, &mat, &cache, &correct);
+        traceObserve(NULL, NULL);
+        const csim_stats_t *st = &cache.stats;
+        printf("func %d (%s): hits:%lu misses:%lu evictions:%lu%s\n", f,
+               func_list[f].description, st->hits, st->misses, st->evictions,
+               correct ? "" : " INCORRECT");
+        simFree(&cache);
+        if (!recorded) {
+            return 1;
+        }
+        if (heat_prefix != NULL &&
+            !write_heatmaps(&heat, heat_prefix, f, heat_csv)) {
+            return 1;
+        }
+
+        if (counters) {
+            flush(A, M * N * sizeof(double));
+            flush(B, M * N * sizeof(double));
+            flush(tmp, sizeof(tmp));
+            perfStart(&pc);
+            func_list[f].func_ptr(M, N, (double(*)[M])A, (double(*)[N])B,
+                                  tmp);
+            perfStop(&pc);
+            print_counters(&pc);
+        }
+    }
+
+    if (counters) {
+        perfClose(&pc);
+    }
+    for (int m = 0; m < 2; m++) {
+        for (int k = 0; k < HEAT_NUM_KINDS; k++) {
+            free(heat.counts[m][k]);
+        }
+    }
+    free_matrices(&mat);
+    return 0;
+}
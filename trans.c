@@ -18,14 +18,45 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "cache.h"
+#include "pool.h"
+#include "trans.h"
+#include "tune.h"
+#include "verify.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define TRANS_X86_SIMD 1
+#endif
+
+/** @brief Number of doubles that fit in one Haswell L1 cache block */
+#define L1_BLOCK_DOUBLES (((size_t)1 << HASWELL_L1_BLOCK) / sizeof(double))
+
+/** @brief Total number of blocks in the Haswell L1 cache */
+#define L1_LINES ((size_t)HASWELL_L1_ASSOC << HASWELL_L1_SET)
+
+/** @brief Number of bytes covered by one way of the Haswell L1 cache */
+#define L1_WAY_BYTES ((size_t)1 << (HASWELL_L1_SET + HASWELL_L1_BLOCK))
+
+/** @brief Returns the smaller of two sizes. */
+static inline size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
 
 /**
  * @brief Checks if B is the transpose of A.
  *
+ * Checks in parallel, in the mode chosen by TRANS_VERIFY (see verify.c), so
+ * that debug builds stay usable at MAXN.
+ *
  * @param[in]     M    Width of A, height of B
  * @param[in]     N    Height of A, width of B
  * @param[in]     A    Source matrix
@@ -34,18 +65,7 @@
  */
 #ifndef NDEBUG
 static bool is_transpose(size_t M, size_t N, double A[N][M], double B[M][N]) {
-    for (size_t i = 0; i < N; i++) {
-        for (size_t j = 0; j < M; ++j) {
-            if (A[i][j] != B[j][i]) {
-                fprintf(stderr,
-                        "Transpose incorrect.  Fails for B[%zd][%zd] = %.3f, "
-                        "A[%zd][%zd] = %.3f\n",
-                        j, i, B[j][i], i, j, A[i][j]);
-                return false;
-            }
-        }
-    }
-    return true;
+    return verifyTranspose(M, N, &A[0][0], &B[0][0]);
 }
 #endif
 
@@ -86,15 +106,1201 @@ static void trans_tmp(size_t M, size_t N, double A[N][M], double B[M][N],
     assert(is_transpose(M, N, A, B));
 }
 
+/** @brief Largest edge of any micro-kernel */
+#define MICRO_MAX_EDGE 8
+
+/**
+ * @brief Struct describing a square in-register transpose micro-kernel
+ *
+ * The kernel transposes the edge x edge block at a (row stride lda) into b
+ * (row stride ldb). Neither pointer needs to be aligned.
+ */
+typedef struct {
+    size_t edge;
+    void (*func_ptr)(const double *a, size_t lda, double *b, size_t ldb);
+    const char *description;
+} micro_kernel_t;
+
+/**
+ * @brief Portable 4x4 micro-kernel, fully unrolled through scalar registers.
+ */
+static void micro_scalar_4x4(const double *a, size_t lda, double *b,
+                             size_t ldb) {
+    const double *a0 = a, *a1 = a + lda, *a2 = a + 2 * lda, *a3 = a + 3 * lda;
+    double r00 = a0[0], r01 = a0[1], r02 = a0[2], r03 = a0[3];
+    double r10 = a1[0], r11 = a1[1], r12 = a1[2], r13 = a1[3];
+    double r20 = a2[0], r21 = a2[1], r22 = a2[2], r23 = a2[3];
+    double r30 = a3[0], r31 = a3[1], r32 = a3[2], r33 = a3[3];
+
+    double *b0 = b, *b1 = b + ldb, *b2 = b + 2 * ldb, *b3 = b + 3 * ldb;
+    b0[0] = r00, b0[1] = r10, b0[2] = r20, b0[3] = r30;
+    b1[0] = r01, b1[1] = r11, b1[2] = r21, b1[3] = r31;
+    b2[0] = r02, b2[1] = r12, b2[2] = r22, b2[3] = r32;
+    b3[0] = r03, b3[1] = r13, b3[2] = r23, b3[3] = r33;
+}
+
+#ifdef TRANS_X86_SIMD
+/**
+ * @brief Loads a 4x4 block and returns its transposed rows in out.
+ *
+ * unpacklo/unpackhi interleave pairs of rows within each 128-bit lane, then
+ * permute2f128 swaps the lanes into place.
+ */
+__attribute__((target("avx2"))) static inline void
+avx2_4x4(const double *a, size_t lda, __m256d out[4]) {
+    __m256d r0 = _mm256_loadu_pd(a);
+    __m256d r1 = _mm256_loadu_pd(a + lda);
+    __m256d r2 = _mm256_loadu_pd(a + 2 * lda);
+    __m256d r3 = _mm256_loadu_pd(a + 3 * lda);
+
+    // t0 = a00 a10 a02 a12, t1 = a01 a11 a03 a13, and likewise for rows 2-3
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+    out[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+    out[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+    out[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+    out[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+/**
+ * @brief AVX2 4x4 micro-kernel.
+ */
+__attribute__((target("avx2"))) static void
+micro_avx2_4x4(const double *a, size_t lda, double *b, size_t ldb) {
+    __m256d out[4];
+    avx2_4x4(a, lda, out);
+    for (size_t k = 0; k < 4; k++) {
+        _mm256_storeu_pd(b + k * ldb, out[k]);
+    }
+}
+
+/**
+ * @brief AVX2 8x8 streaming micro-kernel.
+ *
+ * Four 4x4 register transposes produce whole 64-byte rows of b, which are
+ * written with non-temporal stores. b and ldb * 8 must be 64-byte aligned.
+ */
+__attribute__((target("avx2"))) static void
+stream_avx2_8x8(const double *a, size_t lda, double *b, size_t ldb) {
+    __m256d left[4], right[4];
+    for (size_t j = 0; j < 8; j += 4) {
+        avx2_4x4(a + j, lda, left);
+        avx2_4x4(a + 4 * lda + j, lda, right);
+        for (size_t k = 0; k < 4; k++) {
+            _mm256_stream_pd(b + (j + k) * ldb, left[k]);
+            _mm256_stream_pd(b + (j + k) * ldb + 4, right[k]);
+        }
+    }
+}
+
+/**
+ * @brief Loads an 8x8 block and returns its transposed rows in out.
+ *
+ * Three rounds of shuffles: unpacklo/unpackhi pair up rows, permutex2var
+ * gathers 2x2 blocks into 4x2 columns, and shuffle_f64x2 joins the top and
+ * bottom halves of each column.
+ */
+__attribute__((target("avx512f"))) static inline void
+avx512_8x8(const double *a, size_t lda, __m512d out[8]) {
+    __m512d r[8], t[8], u[8];
+    for (size_t k = 0; k < 8; k++) {
+        r[k] = _mm512_loadu_pd(a + k * lda);
+    }
+
+    for (size_t k = 0; k < 8; k += 2) {
+        t[k] = _mm512_unpacklo_pd(r[k], r[k + 1]);
+        t[k + 1] = _mm512_unpackhi_pd(r[k], r[k + 1]);
+    }
+
+    const __m512i lo = _mm512_set_epi64(13, 12, 5, 4, 9, 8, 1, 0);
+    const __m512i hi = _mm512_set_epi64(15, 14, 7, 6, 11, 10, 3, 2);
+    for (size_t k = 0; k < 8; k += 4) {
+        u[k] = _mm512_permutex2var_pd(t[k], lo, t[k + 2]);
+        u[k + 1] = _mm512_permutex2var_pd(t[k + 1], lo, t[k + 3]);
+        u[k + 2] = _mm512_permutex2var_pd(t[k], hi, t[k + 2]);
+        u[k + 3] = _mm512_permutex2var_pd(t[k + 1], hi, t[k + 3]);
+    }
+
+    for (size_t k = 0; k < 4; k++) {
+        out[k] = _mm512_shuffle_f64x2(u[k], u[k + 4], 0x44);
+        out[k + 4] = _mm512_shuffle_f64x2(u[k], u[k + 4], 0xEE);
+    }
+}
+
+/**
+ * @brief AVX-512 8x8 micro-kernel.
+ */
+__attribute__((target("avx512f"))) static void
+micro_avx512_8x8(const double *a, size_t lda, double *b, size_t ldb) {
+    __m512d out[8];
+    avx512_8x8(a, lda, out);
+    for (size_t k = 0; k < 8; k++) {
+        _mm512_storeu_pd(b + k * ldb, out[k]);
+    }
+}
+
+/**
+ * @brief AVX-512 8x8 streaming micro-kernel.
+ *
+ * Each transposed row is one whole 64-byte line of b, written with a
+ * non-temporal store. b and ldb * 8 must be 64-byte aligned.
+ */
+__attribute__((target("avx512f"))) static void
+stream_avx512_8x8(const double *a, size_t lda, double *b, size_t ldb) {
+    __m512d out[8];
+    avx512_8x8(a, lda, out);
+    for (size_t k = 0; k < 8; k++) {
+        _mm512_stream_pd(b + k * ldb, out[k]);
+    }
+}
+#endif /* TRANS_X86_SIMD */
+
+/**
+ * @brief Returns the micro-kernel for the given instruction set, or NULL if
+ *        the running CPU does not support it or TRANS_ISA rules it out.
+ */
+static const micro_kernel_t *micro_kernel_for(trans_micro_t micro) {
+    static const micro_kernel_t scalar = {4, micro_scalar_4x4,
+                                          "scalar 4x4"};
+#ifdef TRANS_X86_SIMD
+    static const micro_kernel_t avx2 = {4, micro_avx2_4x4, "AVX2 4x4"};
+    static const micro_kernel_t avx512 = {8, micro_avx512_8x8,
+                                          "AVX-512 8x8"};
+#endif
+
+    switch (micro) {
+    case TRANS_MICRO_SCALAR:
+        return &scalar;
+#ifdef TRANS_X86_SIMD
+    case TRANS_MICRO_AVX2:
+        return transIsaSupported(TRANS_ISA_AVX2) ? &avx2 : NULL;
+    case TRANS_MICRO_AVX512:
+        return transIsaSupported(TRANS_ISA_AVX512) ? &avx512 : NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+/** @brief Widest micro-kernel the running CPU supports, once selected */
+static const micro_kernel_t *selected_kernel = NULL;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Selects the widest micro-kernel into selected_kernel.
+ */
+static void select_kernel(void) {
+    for (int m = TRANS_NUM_MICRO - 1; selected_kernel == NULL; m--) {
+        selected_kernel = micro_kernel_for((trans_micro_t)m);
+    }
+}
+
+/**
+ * @brief Returns the widest micro-kernel the running CPU supports.
+ *
+ * The CPU is queried once, on the first call from any thread; later calls
+ * return the cached choice.
+ */
+static const micro_kernel_t *micro_kernel(void) {
+    pthread_once(&kernel_once, select_kernel);
+    return selected_kernel;
+}
+
+/**
+ * @brief Returns a streaming-store micro-kernel for the running CPU, or NULL
+ *        if it has none.
+ *
+ * Streaming kernels write one whole L1 block of B per row, so their edge is
+ * L1_BLOCK_DOUBLES.
+ */
+static const micro_kernel_t *stream_kernel(void) {
+#ifdef TRANS_X86_SIMD
+    static const micro_kernel_t avx2 = {8, stream_avx2_8x8,
+                                        "AVX2 8x8 streaming"};
+    static const micro_kernel_t avx512 = {8, stream_avx512_8x8,
+                                          "AVX-512 8x8 streaming"};
+    if (L1_BLOCK_DOUBLES != 8)
+        return NULL;
+    if (transIsaSupported(TRANS_ISA_AVX512))
+        return &avx512;
+    if (transIsaSupported(TRANS_ISA_AVX2))
+        return &avx2;
+#endif
+    return NULL;
+}
+
+/**
+ * @brief Transposes rows [i0, i1) and columns [j0, j1) of A into B.
+ *
+ * Whole edge x edge squares go through the given micro-kernel; the ragged
+ * right and bottom strips are copied element by element.
+ */
+static void trans_block(size_t M, size_t N, double A[N][M], double B[M][N],
+                        size_t i0, size_t i1, size_t j0, size_t j1,
+                        const micro_kernel_t *kernel) {
+    size_t k = kernel->edge;
+    size_t ik = i0 + (i1 - i0) / k * k;
+    size_t jk = j0 + (j1 - j0) / k * k;
+
+    for (size_t i = i0; i < ik; i += k) {
+        for (size_t j = j0; j < jk; j += k) {
+            kernel->func_ptr(&A[i][j], M, &B[j][i], N);
+        }
+        for (size_t ii = i; ii < i + k; ii++) {
+            for (size_t j = jk; j < j1; j++) {
+                B[j][ii] = A[ii][j];
+            }
+        }
+    }
+    for (size_t i = ik; i < i1; i++) {
+        for (size_t j = j0; j < j1; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/** @brief Edge of the tiles that trans_staged copies through tmp */
+#define STAGE_EDGE L1_BLOCK_DOUBLES
+
+/** @brief Returns the set that addr maps to in the test cache. */
+static inline size_t test_set(const double *addr) {
+    return (uintptr_t)addr >> TEST_LOG_BLOCK & (((size_t)1 << TEST_LOG_SET) - 1);
+}
+
+/**
+ * @brief Chooses one block-aligned row of tmp per staged row, avoiding the
+ *        sets that the current tiles of A and B map to in the test cache.
+ *
+ * If too few sets are free, consecutive rows of tmp are used instead.
+ *
+ * @param[in]  tmp   The temporary array
+ * @param[in]  used  Bit mask of test-cache sets taken by A and B
+ * @param[in]  rows  Number of staged rows needed
+ * @param[out] slots Start of each staged row within tmp
+ */
+static void pick_stage_rows(double tmp[TMPCOUNT], uint64_t used, size_t rows,
+                            double *slots[STAGE_EDGE]) {
+    size_t first = (size_t)(-(uintptr_t)tmp % (1 << TEST_LOG_BLOCK)) /
+                   sizeof(double);
+    size_t lines = (TMPCOUNT - first) / STAGE_EDGE;
+    size_t found = 0;
+
+    for (size_t k = 0; k < lines && found < rows; k++) {
+        double *row = &tmp[first + k * STAGE_EDGE];
+        if (!(used >> test_set(row) & 1)) {
+            slots[found++] = row;
+            used |= (uint64_t)1 << test_set(row);
+        }
+    }
+    if (found < rows) {
+        for (size_t r = 0; r < rows; r++) {
+            slots[r] = &tmp[first + r * STAGE_EDGE];
+        }
+    }
+}
+
+/**
+ * @brief A blocked transpose that stages every tile through tmp.
+ *
+ * When M and N are powers of two, rows of A and B that are a multiple of the
+ * cache's way size apart map to the same set. A diagonal tile of A then
+ * evicts the very lines of B it is writing to, and with few ways even rows
+ * of one tile evict each other. Here each tile of A is first copied whole
+ * into tmp, touching every line of A once, and then each row of B is filled
+ * from tmp, touching every line of B once. The rows of tmp used for a tile
+ * are picked so that they do not share a test-cache set with that tile's
+ * lines of A or B, so tmp itself is not evicted either.
+ */
+static void trans_staged(size_t M, size_t N, double A[N][M], double B[M][N],
+                         double tmp[TMPCOUNT]) {
+    assert(M > 0);
+    assert(N > 0);
+    _Static_assert(STAGE_EDGE * (STAGE_EDGE + 1) <= TMPCOUNT,
+                   "tmp must hold a staged tile plus alignment slack");
+    _Static_assert(TEST_LOG_SET <= 6, "set mask must fit in 64 bits");
+
+    double *slots[STAGE_EDGE];
+    for (size_t ii = 0; ii < N; ii += STAGE_EDGE) {
+        size_t iend = min_size(ii + STAGE_EDGE, N);
+        for (size_t jj = 0; jj < M; jj += STAGE_EDGE) {
+            size_t jend = min_size(jj + STAGE_EDGE, M);
+
+            uint64_t used = 0;
+            for (size_t i = ii; i < iend; i++) {
+                used |= (uint64_t)1 << test_set(&A[i][jj]);
+                used |= (uint64_t)1 << test_set(&A[i][jend - 1]);
+            }
+            for (size_t j = jj; j < jend; j++) {
+                used |= (uint64_t)1 << test_set(&B[j][ii]);
+                used |= (uint64_t)1 << test_set(&B[j][iend - 1]);
+            }
+            pick_stage_rows(tmp, used, jend - jj, slots);
+
+            for (size_t i = ii; i < iend; i++) {
+                for (size_t j = jj; j < jend; j++) {
+                    slots[j - jj][i - ii] = A[i][j];
+                }
+            }
+            for (size_t j = jj; j < jend; j++) {
+                for (size_t i = ii; i < iend; i++) {
+                    B[j][i] = slots[j - jj][i - ii];
+                }
+            }
+        }
+    }
+
+    assert(is_transpose(M, N, A, B));
+}
+
+/**
+ * @brief Picks the tile edge length for a blocked transpose of an M x N matrix.
+ *
+ * A tile is always a whole number of cache blocks wide, which is also a
+ * multiple of every micro-kernel edge. If the row stride of
+ * A or B is a multiple of the L1 way size, every row of a tile maps to the
+ * same set, so the edge is bounded by the associativity. Otherwise it is
+ * bounded by capacity: the tile's blocks of A and B may take up at most half
+ * of the L1, leaving the rest for conflicts.
+ *
+ * @param[in]     M    Width of A, height of B
+ * @param[in]     N    Height of A, width of B
+ * @return The tile edge length, in elements.
+ */
+static size_t tile_size(size_t M, size_t N) {
+    if ((M * sizeof(double)) % L1_WAY_BYTES == 0 ||
+        (N * sizeof(double)) % L1_WAY_BYTES == 0) {
+        size_t t = HASWELL_L1_ASSOC - HASWELL_L1_ASSOC % L1_BLOCK_DOUBLES;
+        return t > 0 ? t : L1_BLOCK_DOUBLES;
+    }
+
+    size_t t = L1_BLOCK_DOUBLES;
+    while (2 * (t + L1_BLOCK_DOUBLES) * (t + L1_BLOCK_DOUBLES) /
+               L1_BLOCK_DOUBLES <=
+           L1_LINES / 2) {
+        t += L1_BLOCK_DOUBLES;
+    }
+    return t;
+}
+
+/**
+ * @brief Transposes A into B in t x t tiles, each one covered by kernel.
+ */
+static void trans_tiles(size_t M, size_t N, double A[N][M], double B[M][N],
+                        size_t t, const micro_kernel_t *kernel) {
+    for (size_t ii = 0; ii < N; ii += t) {
+        size_t iend = min_size(ii + t, N);
+        for (size_t jj = 0; jj < M; jj += t) {
+            trans_block(M, N, A, B, ii, iend, jj, min_size(jj + t, M),
+                        kernel);
+        }
+    }
+}
+
+/**
+ * @brief A blocked transpose whose tile size comes from the L1 geometry.
+ *
+ * Tiles along the right and bottom edges are clipped to the matrix, so any
+ * M x N shape is handled. Each tile is transposed by the micro-kernel.
+ */
+static void trans_tiled(size_t M, size_t N, double A[N][M], double B[M][N],
+                        double tmp[TMPCOUNT]) {
+    assert(M > 0);
+    assert(N > 0);
+
+    trans_tiles(M, N, A, B, tile_size(M, N), micro_kernel());
+
+    assert(is_transpose(M, N, A, B));
+}
+
+/** @brief Edge length below which the recursive transpose stops splitting */
+#define RECURSE_BASE 16
+
+/**
+ * @brief Transposes rows [i0, i1) and columns [j0, j1) of A, splitting the
+ *        longer side in half until the block is at most RECURSE_BASE square.
+ *
+ * Split points are kept on multiples of the micro-kernel edge so the base
+ * case is mostly covered by whole micro-kernel squares.
+ */
+static void trans_recurse(size_t M, size_t N, double A[N][M], double B[M][N],
+                          size_t i0, size_t i1, size_t j0, size_t j1,
+                          const micro_kernel_t *kernel) {
+    size_t rows = i1 - i0;
+    size_t cols = j1 - j0;
+
+    if (rows <= RECURSE_BASE && cols <= RECURSE_BASE) {
+        trans_block(M, N, A, B, i0, i1, j0, j1, kernel);
+        return;
+    }
+
+    size_t k = kernel->edge;
+    if (rows >= cols) {
+        size_t half = rows / 2;
+        if (half > k)
+            half -= half % k;
+        trans_recurse(M, N, A, B, i0, i0 + half, j0, j1, kernel);
+        trans_recurse(M, N, A, B, i0 + half, i1, j0, j1, kernel);
+    } else {
+        size_t half = cols / 2;
+        if (half > k)
+            half -= half % k;
+        trans_recurse(M, N, A, B, i0, i1, j0, j0 + half, kernel);
+        trans_recurse(M, N, A, B, i0, i1, j0 + half, j1, kernel);
+    }
+}
+
+/**
+ * @brief A cache-oblivious transpose that needs no cache parameters.
+ */
+static void trans_recursive(size_t M, size_t N, double A[N][M], double B[M][N],
+                            double tmp[TMPCOUNT]) {
+    assert(M > 0);
+    assert(N > 0);
+
+    trans_recurse(M, N, A, B, 0, N, 0, M, micro_kernel());
+
+    assert(is_transpose(M, N, A, B));
+}
+
+/** @brief Edge length of the square block of A handed to one pool task */
+#define PARALLEL_BLOCK 256
+
+/** @brief Matrices with fewer elements than this are not worth splitting */
+#define PARALLEL_MIN_ELEMS ((size_t)1 << 16)
+
+/**
+ * @brief Struct describing one parallel transpose job for the pool
+ */
+typedef struct {
+    size_t M;           // row stride of A, in elements
+    size_t N;           // row stride of B, in elements
+    size_t rows;        // rows of A to transpose
+    size_t cols;        // columns of A to transpose
+    double *A;          // source matrix
+    double *B;          // destination matrix
+    size_t tile;        // tile edge used inside each block
+    const micro_kernel_t *kernel; // micro-kernel used inside each tile
+    size_t block_cols;  // number of PARALLEL_BLOCK columns across A
+} parallel_job_t;
+
+/**
+ * @brief Pool task: transposes one PARALLEL_BLOCK square of A, tile by tile.
+ *
+ * Blocks on the right and bottom edges are clipped, so they finish early and
+ * the dynamic scheduler hands their threads more work.
+ */
+static void trans_parallel_task(void *arg, size_t task) {
+    const parallel_job_t *job = arg;
+    size_t M = job->M;
+    size_t N = job->N;
+    double(*A)[M] = (double(*)[M])job->A;
+    double(*B)[N] = (double(*)[N])job->B;
+
+    size_t i0 = task / job->block_cols * PARALLEL_BLOCK;
+    size_t j0 = task % job->block_cols * PARALLEL_BLOCK;
+    size_t i1 = min_size(i0 + PARALLEL_BLOCK, job->rows);
+    size_t j1 = min_size(j0 + PARALLEL_BLOCK, job->cols);
+
+    for (size_t ii = i0; ii < i1; ii += job->tile) {
+        size_t iend = min_size(ii + job->tile, i1);
+        for (size_t jj = j0; jj < j1; jj += job->tile) {
+            trans_block(M, N, A, B, ii, iend, jj,
+                        min_size(jj + job->tile, j1), job->kernel);
+        }
+    }
+}
+
+/**
+ * @brief Transposes the first rows x cols elements of A into B on the
+ *        thread pool, in t x t tiles covered by kernel.
+ */
+static void parallel_range(size_t M, size_t N, double A[][M], double B[][N],
+                           size_t rows, size_t cols, size_t t,
+                           const micro_kernel_t *kernel) {
+    parallel_job_t job = {
+        .M = M,
+        .N = N,
+        .rows = rows,
+        .cols = cols,
+        .A = &A[0][0],
+        .B = &B[0][0],
+        .tile = t,
+        .kernel = kernel,
+        .block_cols = (cols + PARALLEL_BLOCK - 1) / PARALLEL_BLOCK,
+    };
+    size_t block_rows = (rows + PARALLEL_BLOCK - 1) / PARALLEL_BLOCK;
+    poolRun(block_rows * job.block_cols, trans_parallel_task, &job);
+}
+
+/**
+ * @brief Transposes A into B on the thread pool, in t x t tiles covered by
+ *        kernel.
+ */
+static void parallel_tiles(size_t M, size_t N, double A[N][M], double B[M][N],
+                           size_t t, const micro_kernel_t *kernel) {
+    parallel_range(M, N, A, B, N, M, t, kernel);
+}
+
+/**
+ * @brief A blocked transpose spread over the persistent thread pool.
+ *
+ * A is cut into PARALLEL_BLOCK squares that the pool schedules dynamically.
+ * Small matrices fall back to trans_tiled on the calling thread.
+ */
+static void trans_parallel(size_t M, size_t N, double A[N][M], double B[M][N],
+                           double tmp[TMPCOUNT]) {
+    assert(M > 0);
+    assert(N > 0);
+
+    if (M * N < PARALLEL_MIN_ELEMS || poolSize() == 1) {
+        trans_tiled(M, N, A, B, tmp);
+        return;
+    }
+
+    parallel_tiles(M, N, A, B, tile_size(M, N), micro_kernel());
+
+    assert(is_transpose(M, N, A, B));
+}
+
+/** @brief LLC size assumed when the OS does not report one */
+#define DEFAULT_LLC_BYTES ((size_t)8 << 20)
+
+/** @brief Size of the last-level cache in bytes, once read */
+static size_t llc_size = DEFAULT_LLC_BYTES;
+static pthread_once_t llc_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Reads the size of the last-level cache into llc_size.
+ */
+static void read_llc(void) {
+    long reported = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    reported = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (reported <= 0)
+        reported = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (reported > 0)
+        llc_size = (size_t)reported;
+}
+
+/**
+ * @brief Returns the size of the last-level cache in bytes.
+ */
+static size_t llc_bytes(void) {
+    pthread_once(&llc_once, read_llc);
+    return llc_size;
+}
+
+/**
+ * @brief Transposes A into B in t x t tiles, writing B with non-temporal
+ *        stores.
+ *
+ * Every streamed row is a whole, aligned cache line of B, so B is never read
+ * for ownership and does not displace A from the caches. That needs a
+ * streaming kernel, a 64-byte aligned B, and N and t multiples of 8. Rows of
+ * B past the last multiple of 8 use ordinary stores. A store fence orders
+ * the streamed lines before return.
+ *
+ * @return False, without touching B, if the requirements are not met.
+ */
+static bool stream_tiles(size_t M, size_t N, double A[N][M], double B[M][N],
+                         size_t t) {
+    const micro_kernel_t *kernel = stream_kernel();
+    if (kernel == NULL || (uintptr_t)&B[0][0] % (1 << HASWELL_L1_BLOCK) != 0 ||
+        N % kernel->edge != 0 || t % kernel->edge != 0) {
+        return false;
+    }
+
+    trans_tiles(M, N, A, B, t, kernel);
+#ifdef TRANS_X86_SIMD
+    _mm_sfence();
+#endif
+    return true;
+}
+
+/**
+ * @brief A blocked transpose that writes B with non-temporal stores.
+ */
+static void trans_streaming(size_t M, size_t N, double A[N][M],
+                            double B[M][N], double tmp[TMPCOUNT]) {
+    assert(M > 0);
+    assert(N > 0);
+
+    if (!stream_tiles(M, N, A, B, tile_size(M, N))) {
+        trans_tiled(M, N, A, B, tmp);
+        return;
+    }
+
+    assert(is_transpose(M, N, A, B));
+}
+
+/**
+ * @brief Streams B when A and B together overflow the LLC, and uses cached
+ *        stores otherwise.
+ */
+static void trans_by_size(size_t M, size_t N, double A[N][M], double B[M][N],
+                          double tmp[TMPCOUNT]) {
+    if (2 * M * N * sizeof(double) > llc_bytes())
+        trans_streaming(M, N, A, B, tmp);
+    else
+        trans_tiled(M, N, A, B, tmp);
+}
+
+/**
+ * @brief Short name of a variant, as used in the tuning table.
+ */
+const char *transposeVariantName(trans_variant_t variant) {
+    static const char *names[TRANS_NUM_VARIANTS] = {
+        [TRANS_TILED] = "tiled",
+        [TRANS_RECURSIVE] = "recursive",
+        [TRANS_STREAMING] = "streaming",
+        [TRANS_PARALLEL] = "parallel",
+    };
+    return variant < TRANS_NUM_VARIANTS ? names[variant] : "unknown";
+}
+
+/**
+ * @brief Short name of a micro-kernel, as used in the tuning table.
+ */
+const char *transposeMicroName(trans_micro_t micro) {
+    static const char *names[TRANS_NUM_MICRO] = {
+        [TRANS_MICRO_SCALAR] = "scalar",
+        [TRANS_MICRO_AVX2] = "avx2",
+        [TRANS_MICRO_AVX512] = "avx512",
+    };
+    return micro < TRANS_NUM_MICRO ? names[micro] : "unknown";
+}
+
+/**
+ * @brief Checks if the running CPU supports the given micro-kernel.
+ */
+bool transposeMicroSupported(trans_micro_t micro) {
+    return micro_kernel_for(micro) != NULL;
+}
+
+/**
+ * @brief Transposes the N x M matrix A into B with explicit parameters.
+ *
+ * An unsupported micro-kernel is replaced by the widest supported one, a
+ * tile of 0 by the L1 default, and a tile that is not a multiple of the
+ * micro-kernel edge is rounded up. A streaming request that B's alignment
+ * or shape cannot honour falls back to cached stores.
+ *
+ * @param[in]     params  Strategy, tile edge and micro-kernel to use
+ * @param[in]     M       Width of A, height of B
+ * @param[in]     N       Height of A, width of B
+ * @param[in]     A       Source matrix, N x M
+ * @param[out]    B       Destination matrix, M x N
+ */
+void transposeWith(const trans_params_t *params, size_t M, size_t N,
+                   double *A, double *B) {
+    assert(M > 0);
+    assert(N > 0);
+
+    double(*a)[M] = (double(*)[M])A;
+    double(*b)[N] = (double(*)[N])B;
+    const micro_kernel_t *kernel = micro_kernel_for(params->micro);
+    if (kernel == NULL) {
+        kernel = micro_kernel();
+    }
+    size_t t = params->tile > 0 ? params->tile : tile_size(M, N);
+    t = (t + kernel->edge - 1) / kernel->edge * kernel->edge;
+
+    switch (params->variant) {
+    case TRANS_RECURSIVE:
+        trans_recurse(M, N, a, b, 0, N, 0, M, kernel);
+        break;
+    case TRANS_STREAMING:
+        if (!stream_tiles(M, N, a, b, t)) {
+            trans_tiles(M, N, a, b, t, kernel);
+        }
+        break;
+    case TRANS_PARALLEL:
+        parallel_tiles(M, N, a, b, t, kernel);
+        break;
+    case TRANS_TILED:
+    default:
+        trans_tiles(M, N, a, b, t, kernel);
+        break;
+    }
+
+    assert(is_transpose(M, N, a, b));
+}
+
+/**
+ * @brief Exchanges the k x k block at A[i][j] with the transpose of the one
+ *        at A[j][i]. When i == j the block is transposed onto itself.
+ */
+static void swap_blocks(size_t N, double A[N][N], size_t i, size_t j,
+                        const micro_kernel_t *kernel) {
+    size_t k = kernel->edge;
+    double upper[MICRO_MAX_EDGE * MICRO_MAX_EDGE];
+    double lower[MICRO_MAX_EDGE * MICRO_MAX_EDGE];
+
+    kernel->func_ptr(&A[i][j], N, upper, k);
+    if (i == j) {
+        for (size_t r = 0; r < k; r++) {
+            memcpy(&A[i + r][j], &upper[r * k], k * sizeof(double));
+        }
+        return;
+    }
+
+    kernel->func_ptr(&A[j][i], N, lower, k);
+    for (size_t r = 0; r < k; r++) {
+        memcpy(&A[j + r][i], &upper[r * k], k * sizeof(double));
+        memcpy(&A[i + r][j], &lower[r * k], k * sizeof(double));
+    }
+}
+
+/**
+ * @brief Transposes the square matrix A in place.
+ *
+ * Tiles on and above the diagonal are visited in the same order as
+ * trans_tiled; each micro-kernel block is swapped with its mirror image
+ * through two register-sized buffers. Rows and columns past the last whole
+ * micro-kernel block are swapped element by element.
+ */
+static void inplace_square(size_t N, double A[N][N]) {
+    const micro_kernel_t *kernel = micro_kernel();
+    size_t k = kernel->edge;
+    size_t t = tile_size(N, N);
+    size_t nk = N / k * k;
+
+    for (size_t ii = 0; ii < nk; ii += t) {
+        size_t iend = min_size(ii + t, nk);
+        for (size_t jj = ii; jj < nk; jj += t) {
+            size_t jend = min_size(jj + t, nk);
+            for (size_t i = ii; i < iend; i += k) {
+                for (size_t j = jj == ii ? i : jj; j < jend; j += k) {
+                    swap_blocks(N, A, i, j, kernel);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = i + 1 > nk ? i + 1 : nk; j < N; j++) {
+            double t = A[i][j];
+            A[i][j] = A[j][i];
+            A[j][i] = t;
+        }
+    }
+}
+
+/**
+ * @brief Transposes the rectangular N x M matrix at a in place.
+ *
+ * Element p of the flattened matrix moves to p * N mod (M * N - 1). Each
+ * permutation cycle is walked once from its smallest index, its leader; a
+ * bitset records every index already placed so later leaders skip it.
+ *
+ * @return False if the bitset could not be allocated, true otherwise.
+ */
+static bool inplace_cycles(size_t M, size_t N, double *a) {
+    size_t last = M * N - 1;
+    uint64_t *visited = calloc(last / 64 + 1, sizeof(uint64_t));
+    if (visited == NULL) {
+        return false;
+    }
+
+    for (size_t leader = 1; leader < last; leader++) {
+        if (visited[leader / 64] >> (leader % 64) & 1) {
+            continue;
+        }
+
+        double carry = a[leader];
+        size_t p = leader;
+        do {
+            size_t next = p * N % last;
+            double t = a[next];
+            a[next] = carry;
+            carry = t;
+            visited[next / 64] |= (uint64_t)1 << (next % 64);
+            p = next;
+        } while (p != leader);
+    }
+
+    free(visited);
+    return true;
+}
+
+/**
+ * @brief Transposes the N x M matrix A in place into an M x N matrix.
+ *
+ * Square matrices use blocked swaps; rectangular ones use cycle following,
+ * which needs M * N bits of scratch space.
+ *
+ * @param[in]     M    Width of A before, height of A after
+ * @param[in]     N    Height of A before, width of A after
+ * @param[in,out] A    Matrix, transposed on return
+ * @return False if scratch space could not be allocated (A is then
+ *         unchanged), true otherwise.
+ */
+bool transposeInPlace(size_t M, size_t N, double *A) {
+    assert(M > 0);
+    assert(N > 0);
+
+    if (M == N) {
+        inplace_square(N, (double(*)[N])A);
+        return true;
+    }
+    if (M == 1 || N == 1) {
+        return true;
+    }
+    return inplace_cycles(M, N, A);
+}
+
+/**
+ * @brief Copies A into B, then transposes B in place.
+ */
+static void trans_inplace(size_t M, size_t N, double A[N][M], double B[M][N],
+                          double tmp[TMPCOUNT]) {
+    assert(M > 0);
+    assert(N > 0);
+
+    memcpy(&B[0][0], &A[0][0], M * N * sizeof(double));
+    if (!transposeInPlace(M, N, &B[0][0])) {
+        trans_tiled(M, N, A, B, tmp);
+    }
+
+    assert(is_transpose(M, N, A, B));
+}
+
+/** @brief Number of matrices a pool task takes from a large batch */
+#define BATCH_CHUNK 64
+
+/**
+ * @brief Function that transposes count square matrices of one fixed edge
+ */
+typedef void (*batch_func_t)(size_t count, const double *A, size_t strideA,
+                             double *B, size_t strideB);
+
+#ifdef TRANS_X86_SIMD
+/**
+ * @brief Transposes one E x E matrix with the AVX2 4x4 core, E a multiple
+ *        of 4. Inlined with a constant E, every loop is fully unrolled.
+ */
+__attribute__((target("avx2"), always_inline)) static inline void
+avx2_square(size_t E, const double *a, double *b) {
+    __m256d out[4];
+    for (size_t i = 0; i < E; i += 4) {
+        for (size_t j = 0; j < E; j += 4) {
+            avx2_4x4(a + i * E + j, E, out);
+            for (size_t k = 0; k < 4; k++) {
+                _mm256_storeu_pd(b + (j + k) * E + i, out[k]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Transposes one E x E matrix with the AVX-512 8x8 core, E a
+ *        multiple of 8. Inlined with a constant E, every loop is fully
+ *        unrolled.
+ */
+__attribute__((target("avx512f"), always_inline)) static inline void
+avx512_square(size_t E, const double *a, double *b) {
+    __m512d out[8];
+    for (size_t i = 0; i < E; i += 8) {
+        for (size_t j = 0; j < E; j += 8) {
+            avx512_8x8(a + i * E + j, E, out);
+            for (size_t k = 0; k < 8; k++) {
+                _mm512_storeu_pd(b + (j + k) * E + i, out[k]);
+            }
+        }
+    }
+}
+
+/** @brief Defines batch_avx2_E, which transposes E x E matrices */
+#define BATCH_AVX2(E)                                                          \
+    __attribute__((target("avx2"))) static void batch_avx2_##E(               \
+        size_t count, const double *A, size_t strideA, double *B,              \
+        size_t strideB) {                                                      \
+        for (size_t c = 0; c < count; c++) {                                   \
+            avx2_square(E, A + c * strideA, B + c * strideB);                  \
+        }                                                                      \
+    }
+
+/** @brief Defines batch_avx512_E, which transposes E x E matrices */
+#define BATCH_AVX512(E)                                                        \
+    __attribute__((target("avx512f"))) static void batch_avx512_##E(          \
+        size_t count, const double *A, size_t strideA, double *B,              \
+        size_t strideB) {                                                      \
+        for (size_t c = 0; c < count; c++) {                                   \
+            avx512_square(E, A + c * strideA, B + c * strideB);                \
+        }                                                                      \
+    }
+
+BATCH_AVX2(4)
+BATCH_AVX2(8)
+BATCH_AVX2(16)
+BATCH_AVX2(32)
+BATCH_AVX2(64)
+BATCH_AVX512(8)
+BATCH_AVX512(16)
+BATCH_AVX512(32)
+BATCH_AVX512(64)
+#endif /* TRANS_X86_SIMD */
+
+/**
+ * @brief Returns a batch function specialized for E x E matrices on the
+ *        running CPU, or NULL if there is none for this edge.
+ */
+static batch_func_t batch_func(size_t E) {
+#ifdef TRANS_X86_SIMD
+    static const struct {
+        size_t edge;
+        trans_micro_t micro;
+        batch_func_t func;
+    } table[] = {
+        {8, TRANS_MICRO_AVX512, batch_avx512_8},
+        {16, TRANS_MICRO_AVX512, batch_avx512_16},
+        {32, TRANS_MICRO_AVX512, batch_avx512_32},
+        {64, TRANS_MICRO_AVX512, batch_avx512_64},
+        {4, TRANS_MICRO_AVX2, batch_avx2_4},
+        {8, TRANS_MICRO_AVX2, batch_avx2_8},
+        {16, TRANS_MICRO_AVX2, batch_avx2_16},
+        {32, TRANS_MICRO_AVX2, batch_avx2_32},
+        {64, TRANS_MICRO_AVX2, batch_avx2_64},
+    };
+
+    for (size_t k = 0; k < sizeof(table) / sizeof(table[0]); k++) {
+        if (table[k].edge == E && transposeMicroSupported(table[k].micro)) {
+            return table[k].func;
+        }
+    }
+#endif
+    return NULL;
+}
+
+/**
+ * @brief Struct describing one batched transpose job for the pool
+ */
+typedef struct {
+    size_t M;           // width of each A, height of each B
+    size_t N;           // height of each A, width of each B
+    size_t count;       // number of matrices
+    const double *A;    // first source matrix
+    size_t strideA;     // doubles from one source matrix to the next
+    double *B;          // first destination matrix
+    size_t strideB;     // doubles from one destination matrix to the next
+    batch_func_t func;  // specialized function, or NULL
+} batch_job_t;
+
+/**
+ * @brief Transposes matrices [first, last) of a batch.
+ */
+static void batch_range(const batch_job_t *job, size_t first, size_t last) {
+    const double *a = job->A + first * job->strideA;
+    double *b = job->B + first * job->strideB;
+
+    if (job->func != NULL) {
+        job->func(last - first, a, job->strideA, b, job->strideB);
+        return;
+    }
+
+    size_t M = job->M;
+    size_t N = job->N;
+    const micro_kernel_t *kernel = micro_kernel();
+    for (size_t c = first; c < last; c++) {
+        trans_block(M, N, (double(*)[M])a, (double(*)[N])b, 0, N, 0, M,
+                    kernel);
+        a += job->strideA;
+        b += job->strideB;
+    }
+}
+
+/**
+ * @brief Pool task: transposes one BATCH_CHUNK of the batch.
+ */
+static void batch_task(void *arg, size_t task) {
+    const batch_job_t *job = arg;
+    size_t first = task * BATCH_CHUNK;
+    batch_range(job, first, min_size(first + BATCH_CHUNK, job->count));
+}
+
+/**
+ * @brief Transposes count N x M matrices of A into the M x N matrices of B.
+ *
+ * Square 4, 8, 16, 32 and 64 edge matrices go through functions specialized
+ * for that edge, which keep whole micro-kernel tiles in registers and make
+ * no calls per matrix. Other shapes use the blocked micro-kernel path. When
+ * the batch holds at least PARALLEL_MIN_ELEMS elements it is split into
+ * chunks of BATCH_CHUNK matrices over the thread pool.
+ *
+ * @param[in]     M       Width of each A, height of each B
+ * @param[in]     N       Height of each A, width of each B
+ * @param[in]     count   Number of matrices
+ * @param[in]     A       First source matrix
+ * @param[in]     strideA Doubles from one source matrix to the next, or 0
+ *                        for contiguous matrices
+ * @param[out]    B       First destination matrix
+ * @param[in]     strideB Doubles from one destination matrix to the next,
+ *                        or 0 for contiguous matrices
+ */
+void transposeBatch(size_t M, size_t N, size_t count, const double *A,
+                    size_t strideA, double *B, size_t strideB) {
+    assert(M > 0);
+    assert(N > 0);
+
+    batch_job_t job = {
+        .M = M,
+        .N = N,
+        .count = count,
+        .A = A,
+        .strideA = strideA > 0 ? strideA : M * N,
+        .B = B,
+        .strideB = strideB > 0 ? strideB : M * N,
+        .func = M == N ? batch_func(M) : NULL,
+    };
+    assert(job.strideA >= M * N);
+    assert(job.strideB >= M * N);
+
+    if (count * M * N < PARALLEL_MIN_ELEMS || poolSize() == 1) {
+        batch_range(&job, 0, count);
+        return;
+    }
+    poolRun((count + BATCH_CHUNK - 1) / BATCH_CHUNK, batch_task, &job);
+}
+
+/**
+ * @brief Transposes a rows x cols view of a larger matrix into a cols x rows
+ *        view of another.
+ *
+ * Element (i, j) of the source view is A[i * lda + j]; it is written to
+ * B[j * ldb + i]. Views are tiled like trans_tiled, with the tile sized from
+ * the leading dimensions, and large views are spread over the thread pool.
+ *
+ * @param[in]     rows  Rows of the source view
+ * @param[in]     cols  Columns of the source view
+ * @param[in]     A     First element of the source view
+ * @param[in]     lda   Leading dimension of A, at least cols
+ * @param[out]    B     First element of the destination view
+ * @param[in]     ldb   Leading dimension of B, at least rows
+ */
+void transposeView(size_t rows, size_t cols, const double *A, size_t lda,
+                   double *B, size_t ldb) {
+    assert(lda >= cols);
+    assert(ldb >= rows);
+    if (rows == 0 || cols == 0) {
+        return;
+    }
+
+    double(*a)[lda] = (double(*)[lda])A;
+    double(*b)[ldb] = (double(*)[ldb])B;
+    const micro_kernel_t *kernel = micro_kernel();
+    size_t t = tile_size(lda, ldb);
+
+    if (rows * cols >= PARALLEL_MIN_ELEMS && poolSize() > 1) {
+        parallel_range(lda, ldb, a, b, rows, cols, t, kernel);
+        return;
+    }
+    for (size_t ii = 0; ii < rows; ii += t) {
+        size_t iend = min_size(ii + t, rows);
+        for (size_t jj = 0; jj < cols; jj += t) {
+            trans_block(lda, ldb, a, b, ii, iend, jj, min_size(jj + t, cols),
+                        kernel);
+        }
+    }
+}
+
+/*
+ * Cost hints for dispatchTrans(). The unit is the traffic of a blocked
+ * transpose with cached stores that fits in the LLC: one read of A and one
+ * write of B. The factors of the other kernels are their median wall-clock
+ * times relative to trans_tiled, from three runs of
+ *
+ *   TRANS_TUNE_FILE=/dev/null ./bench -R -r 41 -m warm 1024x1024
+ *
+ * with trans.c built with -O2 -DNDEBUG by gcc 12 on a one-core AVX-512
+ * Xeon. The ratios seen were basic 3.9-4.8, tmp 10.0-20.2, recursive
+ * 0.95-1.12, inplace 1.17-1.40 and staged 0.94-1.64; the factors are the
+ * medians, rounded. Recursive is within noise of trans_tiled, so it gets
+ * 1.0 and loses the tie to trans_tiled, which is registered first. Rerun
+ * bench on the target host and update them together.
+ */
+
+/*
+ * Most the multithreaded transpose can gain once A and B spill the LLC,
+ * where all threads share the DRAM bandwidth: the DRAM copy roof over the
+ * cold bandwidth of trans_tiled on one thread, 17.8 / 3.3 GB/s in the
+ * bench -R run above.
+ */
+#define PARALLEL_DRAM_SPEEDUP 5.4
+
+/**
+ * @brief Cost of a blocked transpose with cached stores.
+ *
+ * Past the LLC every line of B is also read for ownership before it is
+ * written.
+ */
+static double cost_cached(size_t M, size_t N) {
+    double bytes = 2.0 * (double)(M * N * sizeof(double));
+    return bytes > (double)llc_bytes() ? 1.5 * bytes : bytes;
+}
+
+/**
+ * @brief Cost of a blocked transpose with streaming stores.
+ *
+ * Streamed lines of B skip the cache, so while B would have fit in the LLC
+ * the next reader of B misses on it.
+ */
+static double cost_streaming(size_t M, size_t N) {
+    double bytes = 2.0 * (double)(M * N * sizeof(double));
+    return bytes > (double)llc_bytes() ? bytes : 1.25 * bytes;
+}
+
+static double cost_basic(size_t M, size_t N) {
+    return 4.8 * cost_cached(M, N);
+}
+
+static double cost_tmp(size_t M, size_t N) {
+    return 10.4 * cost_cached(M, N);
+}
+
+static double cost_recursive(size_t M, size_t N) {
+    return 1.0 * cost_cached(M, N);
+}
+
+/**
+ * @brief Cost of the multithreaded blocked transpose.
+ *
+ * Threads divide the work while A and B fit in the LLC; past it they are
+ * bound by the shared DRAM bandwidth, which caps the speedup.
+ */
+static double cost_parallel(size_t M, size_t N) {
+    double speedup = (double)poolSize();
+    if (2.0 * (double)(M * N * sizeof(double)) > (double)llc_bytes() &&
+        speedup > PARALLEL_DRAM_SPEEDUP) {
+        speedup = PARALLEL_DRAM_SPEEDUP;
+    }
+    return cost_cached(M, N) / speedup;
+}
+
+static double cost_inplace(size_t M, size_t N) {
+    return 1.2 * cost_cached(M, N);
+}
+
+static double cost_staged(size_t M, size_t N) {
+    return 1.2 * cost_cached(M, N);
+}
+
 /**
  * @brief The solution transpose function.
+ *
+ * Uses the tuned parameters for this shape and CPU if the tuning table has
+ * them, and the cheapest registered kernel that accepts A and B otherwise.
  */
 static void transpose_submit(size_t M, size_t N, double A[N][M], double B[M][N],
                              double tmp[TMPCOUNT]) {
-    if (M == N)
-        trans_basic(M, N, A, B, tmp);
-    else
-        trans_tmp(M, N, A, B, tmp);
+    trans_params_t params;
+    if (tuneLookup(M, N, &params))
+        transposeWith(&params, M, N, &A[0][0], &B[0][0]);
+    else if (!dispatchTrans(M, N, A, B, tmp))
+        trans_by_size(M, N, A, B, tmp);
 }
 
 /**
@@ -104,7 +1310,37 @@ void registerFunctions(void) {
     // Register the solution function. Do not modify this line!
     registerTransFunction(transpose_submit, SUBMIT_DESCRIPTION);
 
-    // Register any additional transpose functions
-    registerTransFunction(trans_basic, "Basic transpose");
-    registerTransFunction(trans_tmp, "Transpose using the temporary array");
+    // Register any additional transpose functions, with what they handle
+    static const trans_caps_t basic = {.cost = cost_basic};
+    static const trans_caps_t tmp = {.cost = cost_tmp};
+    static const trans_caps_t tiled = {.cost = cost_cached};
+    static const trans_caps_t recursive = {.cost = cost_recursive};
+    static const trans_caps_t parallel = {.min_elems = PARALLEL_MIN_ELEMS,
+                                          .cost = cost_parallel};
+    static const trans_caps_t inplace = {.cost = cost_inplace};
+    static const trans_caps_t streaming = {
+        .n_multiple = L1_BLOCK_DOUBLES,
+        .align = (size_t)1 << HASWELL_L1_BLOCK,
+        .isa = TRANS_ISA_AVX2,
+        .cost = cost_streaming};
+    // No cheaper than its parts, which are dispatched directly when eligible
+    static const trans_caps_t by_size = {.cost = cost_cached};
+    static const trans_caps_t staged = {.cost = cost_staged};
+
+    registerTransKernel(trans_basic, "Basic transpose", &basic);
+    registerTransKernel(trans_tmp, "Transpose using the temporary array", &tmp);
+    registerTransKernel(trans_tiled, "Blocked transpose sized from the L1",
+                        &tiled);
+    registerTransKernel(trans_recursive, "Cache-oblivious recursive transpose",
+                        &recursive);
+    registerTransKernel(trans_parallel, "Multithreaded blocked transpose",
+                        &parallel);
+    registerTransKernel(trans_inplace, "In-place transpose of a copy of A",
+                        &inplace);
+    registerTransKernel(trans_streaming, "Streaming-store blocked transpose",
+                        &streaming);
+    registerTransKernel(trans_by_size, "Streaming or cached stores by size",
+                        &by_size);
+    registerTransKernel(trans_staged, "Blocked transpose staged through tmp",
+                        &staged);
 }
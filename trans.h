@@ -0,0 +1,62 @@
+/**
+ * @file trans.h
+ * @brief Prototypes for transpose routines callable outside the driver
+ */
+
+#ifndef TRANS_TOOLS_H
+#define TRANS_TOOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Blocked transpose strategies that transposeWith() can run */
+typedef enum {
+    TRANS_TILED,     // tiles of an explicit edge, on the calling thread
+    TRANS_RECURSIVE, // cache-oblivious recursion, tile is ignored
+    TRANS_STREAMING, // tiles written with non-temporal stores
+    TRANS_PARALLEL,  // tiles spread over the thread pool
+    TRANS_NUM_VARIANTS
+} trans_variant_t;
+
+/** @brief Instruction sets of the in-register micro-kernels */
+typedef enum {
+    TRANS_MICRO_SCALAR,
+    TRANS_MICRO_AVX2,
+    TRANS_MICRO_AVX512,
+    TRANS_NUM_MICRO
+} trans_micro_t;
+
+/**
+ * @brief Struct representing one point in the transpose tuning space
+ */
+typedef struct {
+    trans_variant_t variant; // blocking strategy
+    size_t tile;             // tile edge in elements, 0 for the L1 default
+    trans_micro_t micro;     // micro-kernel; streaming only falls back to it
+} trans_params_t;
+
+/** @brief Short name of a variant, as used in the tuning table */
+const char *transposeVariantName(trans_variant_t variant);
+
+/** @brief Short name of a micro-kernel, as used in the tuning table */
+const char *transposeMicroName(trans_micro_t micro);
+
+/** @brief Checks if the running CPU supports the given micro-kernel */
+bool transposeMicroSupported(trans_micro_t micro);
+
+/** @brief Transposes the N x M matrix A into B with explicit parameters */
+void transposeWith(const trans_params_t *params, size_t M, size_t N,
+                   double *A, double *B);
+
+/** @brief Transposes the N x M matrix A in place into an M x N matrix */
+bool transposeInPlace(size_t M, size_t N, double *A);
+
+/** @brief Transposes a strided rows x cols view into a cols x rows view */
+void transposeView(size_t rows, size_t cols, const double *A, size_t lda,
+                   double *B, size_t ldb);
+
+/** @brief Transposes a batch of equally shaped N x M matrices */
+void transposeBatch(size_t M, size_t N, size_t count, const double *A,
+                    size_t strideA, double *B, size_t strideB);
+
+#endif /* TRANS_TOOLS_H */
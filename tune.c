@@ -0,0 +1,418 @@
+/**
+ * @file tune.c
+ * @brief Transpose auto-tuner with a persistent tuning table
+ *
+ * The tuner scores every candidate from tuneCandidates() on a shape and
+ * keeps the lowest score. The score is the wall time from tuneTime() by
+ * default; tuner.c can substitute simulated misses. Winners by wall time
+ * live in a text table, one per line:
+ *
+ *   M N variant tile micro score cpu-model
+ *
+ * The table is read from TUNE_FILE in the working directory, or from the
+ * file named by the TRANS_TUNE_FILE environment variable. Only lines whose
+ * cpu-model matches the running CPU are used, so one table can be shared
+ * between hosts. The score column is always in seconds: transpose_submit
+ * dispatches from this table, so winners by any other cost are never
+ * stored.
+ *
+ * @author Yifan Gu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cache.h"
+#include "tune.h"
+
+/** @brief Longest line accepted from the tuning table or /proc/cpuinfo */
+#define TUNE_MAX_LINE 512
+
+/** @brief Shortest time a timed sample should take, in seconds */
+#define TUNE_MIN_SAMPLE 1e-3
+
+/** @brief Tile edges searched for the tiled variants */
+static const size_t tune_tiles[] = {8, 16, 32, 64, 128};
+
+/**
+ * @brief Struct representing one row of the tuning table
+ */
+typedef struct {
+    size_t M;               // width of A
+    size_t N;               // height of A
+    trans_params_t params;  // winning parameters
+    double score;           // score of the winner
+} tune_entry_t;
+
+static pthread_once_t load_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static tune_entry_t *table = NULL; // entries for this CPU only
+static size_t table_len = 0;
+static size_t table_cap = 0;
+
+/**
+ * @brief Returns the path of the tuning table.
+ */
+static const char *tune_path(void) {
+    const char *env = getenv("TRANS_TUNE_FILE");
+    return env != NULL && env[0] != '\0' ? env : TUNE_FILE;
+}
+
+/**
+ * @brief Model name of the running CPU, used to key the tuning table.
+ *
+ * @return The "model name" field of /proc/cpuinfo, or "unknown".
+ */
+const char *tuneCpuModel(void) {
+    static char model[TUNE_MAX_LINE] = "";
+    if (model[0] != '\0') {
+        return model;
+    }
+
+    strcpy(model, "unknown");
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (fp == NULL) {
+        return model;
+    }
+
+    char line[TUNE_MAX_LINE];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && colon != NULL) {
+            colon += strspn(colon + 1, " \t") + 1;
+            colon[strcspn(colon, "\n")] = '\0';
+            snprintf(model, sizeof(model), "%s", colon);
+            break;
+        }
+    }
+    fclose(fp);
+    return model;
+}
+
+/**
+ * @brief Parses one table line.
+ *
+ * @param[in]  line  Line read from the table
+ * @param[out] entry Parsed entry
+ * @param[out] model CPU model on the line, TUNE_MAX_LINE bytes
+ * @return True if the line is well formed, false otherwise
+ */
+static bool parse_entry(const char *line, tune_entry_t *entry, char *model) {
+    char variant[32], micro[32];
+    if (sscanf(line, "%zu %zu %31s %zu %31s %lf %511[^\n]", &entry->M,
+               &entry->N, variant, &entry->params.tile, micro,
+               &entry->score, model) < 7) {
+        return false;
+    }
+
+    int v, m;
+    for (v = 0; v < TRANS_NUM_VARIANTS; v++) {
+        if (strcmp(variant, transposeVariantName((trans_variant_t)v)) == 0)
+            break;
+    }
+    for (m = 0; m < TRANS_NUM_MICRO; m++) {
+        if (strcmp(micro, transposeMicroName((trans_micro_t)m)) == 0)
+            break;
+    }
+    if (v == TRANS_NUM_VARIANTS || m == TRANS_NUM_MICRO) {
+        return false;
+    }
+    entry->params.variant = (trans_variant_t)v;
+    entry->params.micro = (trans_micro_t)m;
+    return true;
+}
+
+/**
+ * @brief Adds or replaces the in-memory entry for entry's shape.
+ */
+static void remember(const tune_entry_t *entry) {
+    for (size_t i = 0; i < table_len; i++) {
+        if (table[i].M == entry->M && table[i].N == entry->N) {
+            table[i] = *entry;
+            return;
+        }
+    }
+
+    if (table_len == table_cap) {
+        size_t cap = table_cap > 0 ? 2 * table_cap : 16;
+        tune_entry_t *grown = realloc(table, cap * sizeof(tune_entry_t));
+        if (grown == NULL) {
+            return;
+        }
+        table = grown;
+        table_cap = cap;
+    }
+    table[table_len++] = *entry;
+}
+
+/**
+ * @brief Loads the entries for this CPU from the table. Runs exactly once.
+ */
+static void load(void) {
+    FILE *fp = fopen(tune_path(), "r");
+    if (fp == NULL) {
+        return;
+    }
+
+    const char *cpu = tuneCpuModel();
+    char line[TUNE_MAX_LINE];
+    char model[TUNE_MAX_LINE];
+    tune_entry_t entry;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (parse_entry(line, &entry, model) && strcmp(model, cpu) == 0 &&
+            transposeMicroSupported(entry.params.micro)) {
+            remember(&entry);
+        }
+    }
+    fclose(fp);
+}
+
+/**
+ * @brief Looks up the stored winner for a shape on this CPU.
+ *
+ * The table is read on the first call only; later calls search memory.
+ *
+ * @param[in]  M      Width of A
+ * @param[in]  N      Height of A
+ * @param[out] params Stored parameters, if found
+ * @return True if the table has an entry for this shape and CPU
+ */
+bool tuneLookup(size_t M, size_t N, trans_params_t *params) {
+    pthread_once(&load_once, load);
+
+    bool found = false;
+    pthread_mutex_lock(&table_lock);
+    for (size_t i = 0; i < table_len; i++) {
+        if (table[i].M == M && table[i].N == N) {
+            *params = table[i].params;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&table_lock);
+    return found;
+}
+
+/**
+ * @brief Writes entry to the table file, replacing any line for the same
+ *        shape and CPU.
+ *
+ * @return True if the table was rewritten, false otherwise
+ */
+static bool store(const tune_entry_t *entry) {
+    const char *path = tune_path();
+    const char *cpu = tuneCpuModel();
+    char tmp_path[TUNE_MAX_LINE];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *out = fopen(tmp_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: failed to open %s: %s\n", tmp_path,
+                strerror(errno));
+        return false;
+    }
+
+    FILE *in = fopen(path, "r");
+    if (in != NULL) {
+        char line[TUNE_MAX_LINE];
+        char model[TUNE_MAX_LINE];
+        tune_entry_t old;
+        while (fgets(line, sizeof(line), in) != NULL) {
+            if (parse_entry(line, &old, model) && old.M == entry->M &&
+                old.N == entry->N && strcmp(model, cpu) == 0) {
+                continue;
+            }
+            fputs(line, out);
+        }
+        fclose(in);
+    }
+
+    fprintf(out, "%zu %zu %s %zu %s %.9f %s\n", entry->M, entry->N,
+            transposeVariantName(entry->params.variant), entry->params.tile,
+            transposeMicroName(entry->params.micro), entry->score, cpu);
+    if (fclose(out) != 0 || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Error: failed to write %s: %s\n", path,
+                strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Fills out with every candidate the tuner searches.
+ *
+ * Each tiled variant is tried with every tile edge and every micro-kernel
+ * the CPU supports; the recursive variant with every micro-kernel. The
+ * streaming variant only uses the widest one, for its cached fallback.
+ *
+ * @param[out] out Candidates, at most max of them
+ * @param[in]  max Capacity of out
+ * @return The number of candidates written
+ */
+size_t tuneCandidates(trans_params_t *out, size_t max) {
+    size_t count = 0;
+    size_t num_tiles = sizeof(tune_tiles) / sizeof(tune_tiles[0]);
+    int widest = TRANS_NUM_MICRO - 1;
+    while (widest > 0 && !transposeMicroSupported((trans_micro_t)widest)) {
+        widest--;
+    }
+
+    for (int v = 0; v < TRANS_NUM_VARIANTS; v++) {
+        for (int m = 0; m < TRANS_NUM_MICRO; m++) {
+            if (!transposeMicroSupported((trans_micro_t)m)) {
+                continue;
+            }
+            if (v == TRANS_STREAMING && m != widest) {
+                continue; // the micro-kernel only matters for fallback
+            }
+            bool tiled = v != TRANS_RECURSIVE;
+            for (size_t t = 0; t < (tiled ? num_tiles : 1); t++) {
+                if (count == max) {
+                    return count;
+                }
+                out[count].variant = (trans_variant_t)v;
+                out[count].micro = (trans_micro_t)m;
+                out[count].tile = tiled ? tune_tiles[t] : 0;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Returns the current time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Compares two doubles for qsort.
+ */
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Median wall time of one transpose with the given parameters.
+ *
+ * Small shapes are repeated inside each sample until it lasts at least
+ * TUNE_MIN_SAMPLE, and the sample is divided by the repeat count.
+ *
+ * @return Seconds per transpose
+ */
+double tuneTime(const trans_params_t *params, size_t M, size_t N, double *A,
+                double *B) {
+    double start = now();
+    transposeWith(params, M, N, A, B);
+    double once = now() - start;
+
+    size_t iters = 1;
+    if (once < TUNE_MIN_SAMPLE) {
+        iters = (size_t)(TUNE_MIN_SAMPLE / (once > 1e-9 ? once : 1e-9)) + 1;
+    }
+
+    double samples[TUNE_REPS];
+    for (size_t r = 0; r < TUNE_REPS; r++) {
+        start = now();
+        for (size_t i = 0; i < iters; i++) {
+            transposeWith(params, M, N, A, B);
+        }
+        samples[r] = (now() - start) / (double)iters;
+    }
+    qsort(samples, TUNE_REPS, sizeof(double), compare_double);
+    return samples[TUNE_REPS / 2];
+}
+
+/**
+ * @brief Allocates a 64-byte aligned matrix of count doubles.
+ */
+static double *alloc_matrix(size_t count) {
+    size_t bytes = (count * sizeof(double) + 63) / 64 * 64;
+    return aligned_alloc(64, bytes);
+}
+
+/**
+ * @brief Searches the parameter space for one shape and stores the winner.
+ *
+ * Every candidate is checked against correctTrans() before it is scored;
+ * a candidate that produces a wrong result is skipped. Only a winner by
+ * tuneTime() is stored in the tuning table.
+ *
+ * @param[in]  M       Width of A
+ * @param[in]  N       Height of A
+ * @param[in]  cost    Scoring function, such as tuneTime()
+ * @param[in]  verbose Print the score of every candidate
+ * @param[out] best    Winning parameters
+ * @param[out] score   Score of the winner
+ * @return False if no candidate could be run, true otherwise
+ */
+bool tuneShape(size_t M, size_t N, tune_cost_t cost, bool verbose,
+               trans_params_t *best, double *score) {
+    trans_params_t candidates[64];
+    size_t count = tuneCandidates(candidates, 64);
+
+    double *A = alloc_matrix(M * N);
+    double *B = alloc_matrix(M * N);
+    double *ref = alloc_matrix(M * N);
+    if (A == NULL || B == NULL || ref == NULL) {
+        fprintf(stderr, "Error: failed to allocate %zux%zu matrices\n", M, N);
+        free(A);
+        free(B);
+        free(ref);
+        return false;
+    }
+    initMatrix(M, N, (double(*)[M])A, (double(*)[N])B);
+    correctTrans(M, N, (double(*)[M])A, (double(*)[N])ref);
+
+    bool found = false;
+    for (size_t c = 0; c < count; c++) {
+        memset(B, 0, M * N * sizeof(double));
+        transposeWith(&candidates[c], M, N, A, B);
+        if (memcmp(B, ref, M * N * sizeof(double)) != 0) {
+            fprintf(stderr, "Warning: %s/%zu/%s gave a wrong result\n",
+                    transposeVariantName(candidates[c].variant),
+                    candidates[c].tile,
+                    transposeMicroName(candidates[c].micro));
+            continue;
+        }
+
+        double t = cost(&candidates[c], M, N, A, B);
+        if (verbose) {
+            printf("  %-10s tile %-4zu %-7s %14.6g\n",
+                   transposeVariantName(candidates[c].variant),
+                   candidates[c].tile, transposeMicroName(candidates[c].micro),
+                   t);
+        }
+        if (!found || t < *score) {
+            *best = candidates[c];
+            *score = t;
+            found = true;
+        }
+    }
+
+    free(A);
+    free(B);
+    free(ref);
+
+    if (found && cost == tuneTime) {
+        tune_entry_t entry = {M, N, *best, *score};
+        pthread_once(&load_once, load);
+        pthread_mutex_lock(&table_lock);
+        remember(&entry);
+        pthread_mutex_unlock(&table_lock);
+        store(&entry);
+    }
+    return found;
+}
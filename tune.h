@@ -0,0 +1,41 @@
+/**
+ * @file tune.h
+ * @brief Prototypes for the transpose auto-tuner and its tuning table
+ */
+
+#ifndef TUNE_TOOLS_H
+#define TUNE_TOOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "trans.h"
+
+/** @brief Default file name of the on-disk tuning table */
+#define TUNE_FILE ".trans_tune"
+
+/** @brief Number of timed runs per candidate; the median is kept */
+#define TUNE_REPS 5
+
+/** @brief Function that scores one candidate; lower is better */
+typedef double (*tune_cost_t)(const trans_params_t *params, size_t M,
+                              size_t N, double *A, double *B);
+
+/** @brief Model name of the running CPU, used to key the tuning table */
+const char *tuneCpuModel(void);
+
+/** @brief Fills out with every candidate the tuner searches; returns count */
+size_t tuneCandidates(trans_params_t *out, size_t max);
+
+/** @brief Median wall time of one transpose with the given parameters */
+double tuneTime(const trans_params_t *params, size_t M, size_t N, double *A,
+                double *B);
+
+/** @brief Searches the parameter space for one shape; stores timed winners */
+bool tuneShape(size_t M, size_t N, tune_cost_t cost, bool verbose,
+               trans_params_t *best, double *score);
+
+/** @brief Looks up the stored winner for a shape on this CPU */
+bool tuneLookup(size_t M, size_t N, trans_params_t *params);
+
+#endif /* TUNE_TOOLS_H */
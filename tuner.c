@@ -0,0 +1,132 @@
+/**
+ * @file tuner.c
+ * @author Yifan Gu
+ * @brief Command-line driver for the transpose auto-tuner
+ *
+ * Command-line usage:
+ *   ./tuner [-v] [-S] <M>x<N> [<M>x<N> ...]
+ *   ./tuner -h
+ *
+ * -h    Print this help message and exit
+ * -v    Verbose mode: print the score of every candidate
+ * -S    Score by simulated Haswell L1 misses instead of wall time
+ *
+ * Each winner by wall time is written to the tuning table (see tune.c),
+ * where transpose_submit picks it up on later runs. Winners by simulated
+ * misses are only printed: runtime dispatch must not follow a cache-model
+ * score. -S needs trans.c compiled
+ * with TRACE_CFLAGS (see tracesim.c); that build is too slow to time, so
+ * tune by wall time with a normal build.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cache.h"
+#include "sim.h"
+#include "trace.h"
+#include "tune.h"
+
+/**
+ * @brief Scores a candidate by its misses in a simulated Haswell L1.
+ *
+ * Streaming candidates are ruled out: the recorder cannot see their
+ * non-temporal stores, so their score would be too low.
+ */
+static double simulatedMisses(const trans_params_t *params, size_t M,
+                              size_t N, double *A, double *B) {
+    if (params->variant == TRANS_STREAMING) {
+        return HUGE_VAL;
+    }
+
+    sim_cache_t cache;
+    if (!simInit(&cache, HASWELL_L1_SET, HASWELL_L1_ASSOC,
+                 HASWELL_L1_BLOCK)) {
+        printf("Invalid cache memory\n");
+        exit(1);
+    }
+
+    traceClear();
+    traceWatch(A, M * N * sizeof(double));
+    traceWatch(B, M * N * sizeof(double));
+    traceStart(&cache);
+    transposeWith(params, M, N, A, B);
+    traceStop();
+
+    if (traceCount() == 0) {
+        printf("Error: no accesses recorded; compile trans.c with %s\n",
+               TRACE_CFLAGS);
+        exit(1);
+    }
+    double misses = (double)cache.stats.misses;
+    simFree(&cache);
+    return misses;
+}
+
+/**
+ * @brief Print help message when -h option is called or param error.
+ */
+static void printHelpMessage(void) {
+    printf("Usage: ./tuner [-v] [-S] <M>x<N> [<M>x<N> ...]\n");
+    printf("       ./tuner -h\n\n");
+    printf("  -h            Print this help message and exit\n");
+    printf("  -v            Verbose mode: print the score of every candidate\n");
+    printf("  -S            Score by simulated Haswell L1 misses\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool verbose = false;
+    tune_cost_t cost = tuneTime;
+    int opt;
+    while ((opt = getopt(argc, argv, "hvS")) != -1) {
+        switch (opt) {
+        case 'h':
+            printHelpMessage();
+            return 0;
+        case 'v':
+            verbose = true;
+            break;
+        case 'S':
+            cost = simulatedMisses;
+            setenv("TRANS_THREADS", "1", 1);
+            break;
+        default:
+            printHelpMessage();
+            return 1;
+        }
+    }
+    if (optind == argc) {
+        printHelpMessage();
+        return 1;
+    }
+
+    printf("CPU: %s\n", tuneCpuModel());
+    for (int i = optind; i < argc; i++) {
+        size_t M, N;
+        if (sscanf(argv[i], "%zux%zu", &M, &N) != 2 || M == 0 || N == 0 ||
+            M > MAXN || N > MAXN) {
+            printf("Invalid shape: %s\n", argv[i]);
+            return 1;
+        }
+
+        printf("%zux%zu\n", M, N);
+        trans_params_t best;
+        double score;
+        if (!tuneShape(M, N, cost, verbose, &best, &score)) {
+            return 1;
+        }
+        printf("  best: %s tile %zu %s, ", transposeVariantName(best.variant),
+               best.tile, transposeMicroName(best.micro));
+        if (cost == tuneTime) {
+            printf("%.3f us (%.2f GB/s)\n", score * 1e6,
+                   2.0 * (double)(M * N * sizeof(double)) / score / 1e9);
+        } else {
+            printf("%.0f simulated misses (not stored)\n", score);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,293 @@
+/**
+ * @file verify.c
+ * @brief Checks that B is the transpose of A, quickly enough for MAXN
+ *
+ * Exact checking walks A and B in tiles, so that B's columns come from a
+ * few cache lines rather than one line per element, and spreads row bands
+ * of A over the thread pool. The inner loop accumulates mismatches without
+ * branching so that the compiler can vectorize it; the position of a
+ * mismatch is only looked for once a tile is known to contain one.
+ *
+ * The checksum mode reads A and B once each in memory order. Each element
+ * is hashed together with its position in A, so the sum of the hashes over
+ * A equals the sum over B exactly when, with high probability, every value
+ * landed in its transposed place. The sampled mode compares a fixed number
+ * of pseudo-random elements and is the cheapest, but only catches errors
+ * that touch many elements.
+ *
+ * verifyTranspose() reads its mode from the TRANS_VERIFY environment
+ * variable: exact (the default), checksum, sampled or off.
+ *
+ * @author Yifan Gu
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "verify.h"
+
+/** @brief Edge of the tiles compared at a time in exact mode */
+#define VERIFY_TILE 32
+
+/** @brief Rows of A handed to one pool task */
+#define VERIFY_BAND 64
+
+/** @brief SplitMix64 increment */
+#define VERIFY_GAMMA 0x9e3779b97f4a7c15ULL
+
+/**
+ * @brief Struct representing one verification job on the pool
+ */
+typedef struct {
+    size_t M;
+    size_t N;
+    const double *A;
+    const double *B;
+    atomic_bool failed;              // exact mode: a mismatch was seen
+    _Atomic uint64_t sum[2];         // checksum mode: hashes of A and B
+} verify_job_t;
+
+static const char *const mode_names[VERIFY_NUM_MODES] = {
+    [VERIFY_EXACT] = "exact",
+    [VERIFY_CHECKSUM] = "checksum",
+    [VERIFY_SAMPLED] = "sampled",
+    [VERIFY_OFF] = "off",
+};
+
+static verify_mode_t mode = VERIFY_EXACT;
+static pthread_once_t mode_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Mixes 64 bits into a well-distributed hash (SplitMix64).
+ */
+static inline uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Bit pattern of a double, so that hashes and comparisons are exact.
+ */
+static inline uint64_t bits_of(double x) {
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+/**
+ * @brief Reports the first mismatch inside one tile.
+ */
+static void report(const verify_job_t *job, size_t i0, size_t i1, size_t j0,
+                   size_t j1) {
+    size_t M = job->M;
+    size_t N = job->N;
+    for (size_t i = i0; i < i1; i++) {
+        for (size_t j = j0; j < j1; j++) {
+            double a = job->A[i * M + j];
+            double b = job->B[j * N + i];
+            if (bits_of(a) != bits_of(b)) {
+                fprintf(stderr,
+                        "Transpose incorrect.  Fails for B[%zd][%zd] = %.3f, "
+                        "A[%zd][%zd] = %.3f\n",
+                        j, i, b, i, j, a);
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Compares one band of VERIFY_BAND rows of A with B, tile by tile.
+ */
+static void exact_task(void *arg, size_t task) {
+    verify_job_t *job = arg;
+    size_t M = job->M;
+    size_t N = job->N;
+    size_t iend = (task + 1) * VERIFY_BAND < N ? (task + 1) * VERIFY_BAND : N;
+
+    for (size_t ii = task * VERIFY_BAND; ii < iend; ii += VERIFY_TILE) {
+        size_t i1 = ii + VERIFY_TILE < iend ? ii + VERIFY_TILE : iend;
+        for (size_t jj = 0; jj < M; jj += VERIFY_TILE) {
+            size_t j1 = jj + VERIFY_TILE < M ? jj + VERIFY_TILE : M;
+            uint64_t diff = 0;
+            for (size_t j = jj; j < j1; j++) {
+                const double *b = &job->B[j * N];
+                for (size_t i = ii; i < i1; i++) {
+                    diff |= bits_of(job->A[i * M + j]) ^ bits_of(b[i]);
+                }
+            }
+            if (diff != 0) {
+                if (!atomic_exchange(&job->failed, true)) {
+                    report(job, ii, i1, jj, j1);
+                }
+                return;
+            }
+        }
+        if (atomic_load_explicit(&job->failed, memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Checks if B is the transpose of A, comparing every element.
+ *
+ * Values are compared bit for bit, so a NaN copied correctly matches.
+ * The first mismatch found is printed to stderr.
+ *
+ * @param[in] M Width of A, height of B
+ * @param[in] N Height of A, width of B
+ * @param[in] A Source matrix
+ * @param[in] B Destination matrix
+ * @return True if B is the transpose of A, and false otherwise.
+ */
+bool verifyExact(size_t M, size_t N, const double *A, const double *B) {
+    verify_job_t job = {.M = M, .N = N, .A = A, .B = B};
+    atomic_init(&job.failed, false);
+    poolRun((N + VERIFY_BAND - 1) / VERIFY_BAND, exact_task, &job);
+    return !atomic_load(&job.failed);
+}
+
+/**
+ * @brief Hashes one band of rows of A (even tasks) or of B (odd tasks).
+ */
+static void checksum_task(void *arg, size_t task) {
+    verify_job_t *job = arg;
+    size_t M = job->M;
+    size_t N = job->N;
+    bool of_b = task % 2 == 1;
+    size_t rows = of_b ? M : N;
+    size_t cols = of_b ? N : M;
+    const double *X = of_b ? job->B : job->A;
+    size_t r0 = task / 2 * VERIFY_BAND;
+    size_t r1 = r0 + VERIFY_BAND < rows ? r0 + VERIFY_BAND : rows;
+
+    uint64_t sum = 0;
+    for (size_t r = r0; r < r1; r++) {
+        for (size_t c = 0; c < cols; c++) {
+            // Position in A: row r, column c of A, or row c, column r of B
+            uint64_t pos = of_b ? (uint64_t)(c * M + r) : (uint64_t)(r * M + c);
+            sum += mix(bits_of(X[r * cols + c]) + pos * VERIFY_GAMMA);
+        }
+    }
+    atomic_fetch_add(&job->sum[of_b], sum);
+}
+
+/**
+ * @brief Checks if B is the transpose of A by comparing hashes.
+ *
+ * Each element is hashed with its position in A, and the hashes of A and B
+ * are summed, so the sums agree whatever order the elements are visited in.
+ * A wrong B goes unnoticed only if the sums collide, with probability about
+ * 2^-64.
+ *
+ * @param[in] M Width of A, height of B
+ * @param[in] N Height of A, width of B
+ * @param[in] A Source matrix
+ * @param[in] B Destination matrix
+ * @return True if the hashes of A and B agree, and false otherwise.
+ */
+bool verifyChecksum(size_t M, size_t N, const double *A, const double *B) {
+    verify_job_t job = {.M = M, .N = N, .A = A, .B = B};
+    atomic_init(&job.sum[0], 0);
+    atomic_init(&job.sum[1], 0);
+    size_t bands = ((M > N ? M : N) + VERIFY_BAND - 1) / VERIFY_BAND;
+    poolRun(2 * bands, checksum_task, &job);
+    if (atomic_load(&job.sum[0]) != atomic_load(&job.sum[1])) {
+        fprintf(stderr, "Transpose incorrect.  Checksums of A and B differ\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks if B is the transpose of A at count sampled elements.
+ *
+ * The first and last elements are always among the samples, since off-by-one
+ * errors tend to show up there.
+ *
+ * @param[in] M     Width of A, height of B
+ * @param[in] N     Height of A, width of B
+ * @param[in] A     Source matrix
+ * @param[in] B     Destination matrix
+ * @param[in] count Number of elements to compare
+ * @param[in] seed  Seed of the sample positions
+ * @return True if every sample matches, and false otherwise.
+ */
+bool verifySampled(size_t M, size_t N, const double *A, const double *B,
+                   size_t count, unsigned long seed) {
+    uint64_t elems = (uint64_t)M * N;
+    for (size_t k = 0; k < count; k++) {
+        uint64_t n;
+        if (k == 0)
+            n = 0;
+        else if (k == 1)
+            n = elems - 1;
+        else
+            n = mix(seed + k * VERIFY_GAMMA) % elems;
+        size_t i = (size_t)(n / M);
+        size_t j = (size_t)(n % M);
+        if (bits_of(A[i * M + j]) != bits_of(B[j * N + i])) {
+            fprintf(stderr,
+                    "Transpose incorrect.  Fails for B[%zd][%zd] = %.3f, "
+                    "A[%zd][%zd] = %.3f\n",
+                    j, i, B[j * N + i], i, j, A[i * M + j]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the mode from TRANS_VERIFY.
+ */
+static void read_mode(void) {
+    const char *env = getenv("TRANS_VERIFY");
+    if (env == NULL) {
+        return;
+    }
+    for (int m = 0; m < VERIFY_NUM_MODES; m++) {
+        if (strcmp(env, mode_names[m]) == 0) {
+            mode = (verify_mode_t)m;
+            return;
+        }
+    }
+    fprintf(stderr, "Warning: unknown TRANS_VERIFY mode %s, using exact\n",
+            env);
+}
+
+/**
+ * @brief The mode verifyTranspose() uses.
+ */
+verify_mode_t verifyMode(void) {
+    pthread_once(&mode_once, read_mode);
+    return mode;
+}
+
+/**
+ * @brief Checks B against A in the mode set by TRANS_VERIFY.
+ *
+ * @param[in] M Width of A, height of B
+ * @param[in] N Height of A, width of B
+ * @param[in] A Source matrix
+ * @param[in] B Destination matrix
+ * @return False if the check found B is not the transpose of A.
+ */
+bool verifyTranspose(size_t M, size_t N, const double *A, const double *B) {
+    switch (verifyMode()) {
+    case VERIFY_CHECKSUM:
+        return verifyChecksum(M, N, A, B);
+    case VERIFY_SAMPLED:
+        return verifySampled(M, N, A, B, VERIFY_SAMPLES, (unsigned long)M * N);
+    case VERIFY_OFF:
+        return true;
+    default:
+        return verifyExact(M, N, A, B);
+    }
+}
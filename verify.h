@@ -0,0 +1,42 @@
+/**
+ * @file verify.h
+ * @brief Prototypes for transpose verification
+ */
+
+#ifndef VERIFY_TOOLS_H
+#define VERIFY_TOOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Number of elements checked in VERIFY_SAMPLED mode */
+#define VERIFY_SAMPLES 4096
+
+/**
+ * @brief Enum of the ways a transpose can be checked
+ */
+typedef enum {
+    VERIFY_EXACT,    // every element compared
+    VERIFY_CHECKSUM, // transpose-invariant hashes of A and B compared
+    VERIFY_SAMPLED,  // VERIFY_SAMPLES pseudo-random elements compared
+    VERIFY_OFF,      // nothing checked
+    VERIFY_NUM_MODES
+} verify_mode_t;
+
+/** @brief Checks if B is the transpose of A, comparing every element */
+bool verifyExact(size_t M, size_t N, const double *A, const double *B);
+
+/** @brief Checks if B is the transpose of A by comparing hashes */
+bool verifyChecksum(size_t M, size_t N, const double *A, const double *B);
+
+/** @brief Checks if B is the transpose of A at count sampled elements */
+bool verifySampled(size_t M, size_t N, const double *A, const double *B,
+                   size_t count, unsigned long seed);
+
+/** @brief Checks B against A in the mode set by TRANS_VERIFY */
+bool verifyTranspose(size_t M, size_t N, const double *A, const double *B);
+
+/** @brief The mode verifyTranspose() uses */
+verify_mode_t verifyMode(void);
+
+#endif /* VERIFY_TOOLS_H */